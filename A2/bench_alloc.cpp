@@ -0,0 +1,132 @@
+/**
+ * @file   bench_alloc.cpp
+ * @brief  Standard containers on the allocators of mm_allocator.hpp versus std::allocator.
+ *
+ * Each container is filled with `count` elements (default 100000, or the
+ * first argument), walked once and destroyed. The sum column must be the
+ * same for every allocator of a container.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include "mm_allocator.hpp"
+
+typedef std::pair<const int, int> MapValue;
+
+static SimpleArena *arena = NULL;
+
+/**
+ * @name   now_ns
+ * @brief  Monotonic clock in nanoseconds.
+ */
+static double now_ns() {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @name   key
+ * @brief  Key of element n, a permutation of 0..count-1 so map inserts are not in order.
+ */
+static int key(unsigned n, unsigned count) {
+    return (int)((n * 2654435761u) % count);
+}
+
+/**
+ * @name   run_list
+ * @brief  push_back, walk and destroy a std::list.
+ */
+template <class Alloc>
+static long run_list(const Alloc &alloc, unsigned count) {
+    std::list<int, Alloc> list(alloc);
+    for (unsigned n = 0; n < count; n++) list.push_back((int)n);
+    long sum = 0;
+    for (typename std::list<int, Alloc>::const_iterator it = list.begin(); it != list.end(); ++it) sum += *it;
+    return sum;
+}
+
+/**
+ * @name   run_map
+ * @brief  Insert shuffled keys, walk and destroy a std::map.
+ */
+template <class Alloc>
+static long run_map(const Alloc &alloc, unsigned count) {
+    std::map<int, int, std::less<int>, Alloc> map(std::less<int>(), alloc);
+    for (unsigned n = 0; n < count; n++) map[key(n, count)] = (int)n;
+    long sum = 0;
+    for (typename std::map<int, int, std::less<int>, Alloc>::const_iterator it = map.begin(); it != map.end(); ++it) {
+        sum += it->first ^ it->second;
+    }
+    return sum;
+}
+
+/**
+ * @name   run_vector
+ * @brief  push_back without reserve, walk and destroy a std::vector.
+ */
+template <class Alloc>
+static long run_vector(const Alloc &alloc, unsigned count) {
+    std::vector<int, Alloc> vector(alloc);
+    for (unsigned n = 0; n < count; n++) vector.push_back((int)n);
+    long sum = 0;
+    for (size_t n = 0; n < vector.size(); n++) sum += vector[n];
+    return sum;
+}
+
+/**
+ * @name   report
+ * @brief  Time one run and print it, resetting the arena afterwards.
+ */
+static void report(const char *container, const char *allocator, long (*run)(unsigned), unsigned count) {
+    double t0 = now_ns();
+    long sum = run(count);
+    double t1 = now_ns();
+    simple_arena_reset(arena);
+    printf("%-8s %-8s %-14.1f %ld\n", container, allocator, (t1 - t0) / count, sum);
+}
+
+/* Each container on each allocator, as plain functions for report */
+template <template <class> class Alloc>
+struct Runs {
+    static long list(unsigned count) { return run_list(Alloc<int>(), count); }
+    static long map(unsigned count) { return run_map(Alloc<MapValue>(), count); }
+    static long vector(unsigned count) { return run_vector(Alloc<int>(), count); }
+};
+
+static long list_arena(unsigned count) { return run_list(simple_mm::ArenaAllocator<int>(arena), count); }
+static long map_arena(unsigned count) { return run_map(simple_mm::ArenaAllocator<MapValue>(arena), count); }
+static long vector_arena(unsigned count) { return run_vector(simple_mm::ArenaAllocator<int>(arena), count); }
+
+/**
+ * @name   main
+ * @brief  Runs every container on every allocator.
+ * @return 0 for success, 1 if the arena could not be created.
+ */
+int main(int argc, char **argv) {
+    unsigned count = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 10) : 100000;
+    if (count == 0) count = 100000;
+    arena = simple_arena_create();
+    if (arena == NULL) return 1;
+
+    printf("%-8s %-8s %-14s %s\n", "type", "alloc", "ns/element", "sum");
+    report("list", "std", Runs<std::allocator>::list, count);
+    report("list", "simple", Runs<simple_mm::Allocator>::list, count);
+    report("list", "node", Runs<simple_mm::NodeAllocator>::list, count);
+    report("list", "arena", list_arena, count);
+    report("map", "std", Runs<std::allocator>::map, count);
+    report("map", "simple", Runs<simple_mm::Allocator>::map, count);
+    report("map", "node", Runs<simple_mm::NodeAllocator>::map, count);
+    report("map", "arena", map_arena, count);
+    report("vector", "std", Runs<std::allocator>::vector, count);
+    report("vector", "simple", Runs<simple_mm::Allocator>::vector, count);
+    report("vector", "node", Runs<simple_mm::NodeAllocator>::vector, count);
+    report("vector", "arena", vector_arena, count);
+
+    simple_arena_destroy(arena);
+    return 0;
+}
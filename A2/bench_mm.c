@@ -0,0 +1,1007 @@
+/**
+ * @file   bench_mm.c
+ * @brief  Micro benchmarks for the memory management subsystem.
+ *
+ * Run without arguments to execute every benchmark, or pass the name
+ * of one benchmark followed by its arguments, e.g. `./bench_mm free` or
+ * `./bench_mm trace traces/random.rep`.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <malloc.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+#if defined(MM_THREADS) || defined(MM_HANDLES)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mm.h"
+#include "mm_pool.h"
+#include "mm_arena.h"
+
+/* Choose which malloc/free to benchmark */
+#define MALLOC simple_malloc
+#define FREE   simple_free
+
+#define MAX_LIVE_BLOCKS (128 * 1024)
+
+static void *ptrs[MAX_LIVE_BLOCKS];
+
+/**
+ * @name   now_ns
+ * @brief  Monotonic clock in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @name   bench_free
+ * @brief  Free latency as a function of the number of live blocks.
+ *
+ * Every odd block is freed first (no neighbour is free), then every even
+ * block (both neighbours are free). The ns/free column should stay flat
+ * as the heap grows when coalescing is constant time.
+ */
+static void bench_free(int argc, char **argv) {
+    printf("%-10s %-12s %-12s %-12s\n", "live", "ns/free", "odd ns/free", "even ns/free");
+    for (uint32_t live = 1024; live <= MAX_LIVE_BLOCKS; live *= 2) {
+        for (uint32_t n = 0; n < live; n++) {
+            ptrs[n] = MALLOC(32);
+            if (ptrs[n] == NULL) {
+                printf("Allocation failed at %u live blocks\n", n);
+                return;
+            }
+        }
+
+        uint64_t t0 = now_ns();
+        for (uint32_t n = 1; n < live; n += 2) {
+            FREE(ptrs[n]);
+        }
+        uint64_t t1 = now_ns();
+        for (uint32_t n = 0; n < live; n += 2) {
+            FREE(ptrs[n]);
+        }
+        uint64_t t2 = now_ns();
+
+        double half = live / 2.0;
+        printf("%-10u %-12.1f %-12.1f %-12.1f\n", live,
+               (t2 - t0) / (double)live, (t1 - t0) / half, (t2 - t1) / half);
+    }
+}
+
+/**
+ * @name   bench_malloc
+ * @brief  Allocation latency as a function of heap occupancy.
+ *
+ * The heap is filled with live blocks separated by holes too small for the
+ * requests that follow. Each round frees a random live block and times one
+ * allocation that cannot be served from the holes.
+ */
+static void bench_malloc(int argc, char **argv) {
+    printf("%-10s %-12s %-12s %-12s\n", "live", "ns/malloc", "max visits", "frag");
+    for (uint32_t live = 1024; live <= MAX_LIVE_BLOCKS / 2; live *= 2) {
+        for (uint32_t n = 0; n < 2 * live; n++) {
+            ptrs[n] = MALLOC(32);
+            if (ptrs[n] == NULL) {
+                printf("Allocation failed at %u live blocks\n", n);
+                return;
+            }
+        }
+        for (uint32_t n = 1; n < 2 * live; n += 2) {
+            FREE(ptrs[n]);
+        }
+
+        SimpleStats before, after;
+        simple_mm_stats(&before);
+
+        srand(1);
+        uint64_t total = 0;
+        const uint32_t rounds = 4096;
+        for (uint32_t r = 0; r < rounds; r++) {
+            uint32_t victim = 2 * (rand() % live);
+            FREE(ptrs[victim]);
+            uint64_t t0 = now_ns();
+            ptrs[victim] = MALLOC(128);
+            total += now_ns() - t0;
+        }
+        simple_mm_stats(&after);
+
+        // Bound of the highest histogram bucket the rounds reached
+        int bucket = MM_SEARCH_BUCKETS - 1;
+        while (bucket > 0 && after.search_histogram[bucket] == before.search_histogram[bucket]) bucket--;
+
+        for (uint32_t n = 0; n < 2 * live; n += 2) {
+            FREE(ptrs[n]);
+        }
+        int open_ended = (bucket == MM_SEARCH_BUCKETS - 1);
+        printf("%-10u %-12.1f %-2s%-10lu %-12.3f\n", live, total / (double)rounds,
+               open_ended ? ">=" : "<", open_ended ? 1ul << (bucket - 1) : 1ul << bucket, after.fragmentation);
+    }
+}
+
+/**
+ * @name   bench_pool
+ * @brief  Allocation and free of 16-byte objects from a pool versus MALLOC/FREE.
+ *
+ * Objects are allocated in bulk, then half of them are freed and reallocated
+ * the way cmd_int appends and removes nodes. The span column is the address
+ * range covered by the live objects divided by their number.
+ */
+static void bench_pool(int argc, char **argv) {
+    const uint32_t count = MAX_LIVE_BLOCKS;
+    printf("%-8s %-12s %-12s %-12s\n", "source", "ns/alloc", "ns/free", "bytes/object");
+
+    for (int use_pool = 0; use_pool <= 1; use_pool++) {
+        SimplePool *pool = use_pool ? simple_pool_create(16) : NULL;
+        uint64_t alloc_ns = 0, free_ns = 0;
+
+        uint64_t t0 = now_ns();
+        for (uint32_t n = 0; n < count; n++) {
+            ptrs[n] = use_pool ? simple_pool_alloc(pool) : MALLOC(16);
+        }
+        alloc_ns += now_ns() - t0;
+
+        uintptr_t low = UINTPTR_MAX, high = 0;
+        for (uint32_t n = 0; n < count; n++) {
+            if ((uintptr_t)ptrs[n] < low) low = (uintptr_t)ptrs[n];
+            if ((uintptr_t)ptrs[n] > high) high = (uintptr_t)ptrs[n];
+        }
+
+        t0 = now_ns();
+        for (uint32_t n = 0; n < count; n += 2) {
+            if (use_pool) simple_pool_free(pool, ptrs[n]); else FREE(ptrs[n]);
+        }
+        free_ns += now_ns() - t0;
+
+        t0 = now_ns();
+        for (uint32_t n = 0; n < count; n += 2) {
+            ptrs[n] = use_pool ? simple_pool_alloc(pool) : MALLOC(16);
+        }
+        alloc_ns += now_ns() - t0;
+
+        t0 = now_ns();
+        for (uint32_t n = 0; n < count; n++) {
+            if (use_pool) simple_pool_free(pool, ptrs[n]); else FREE(ptrs[n]);
+        }
+        free_ns += now_ns() - t0;
+        simple_pool_destroy(pool);
+
+        printf("%-8s %-12.1f %-12.1f %-12.1f\n", use_pool ? "pool" : "malloc",
+               alloc_ns / (count * 1.5), free_ns / (count * 1.5), (high + 16 - low) / (double)count);
+    }
+}
+
+/**
+ * @name   bench_arena
+ * @brief  Building and discarding a structure of 16-byte nodes, freed one by one or with an arena reset.
+ *
+ * This is the lifetime of the collection in cmd_int: every node is
+ * allocated, then the whole structure is thrown away at once.
+ */
+static void bench_arena(int argc, char **argv) {
+    const uint32_t count = MAX_LIVE_BLOCKS;
+    const uint32_t rounds = 8;
+    printf("%-8s %-12s %-12s\n", "source", "ns/alloc", "ns/free");
+
+    for (int use_arena = 0; use_arena <= 1; use_arena++) {
+        SimpleArena *arena = use_arena ? simple_arena_create() : NULL;
+        uint64_t alloc_ns = 0, free_ns = 0;
+
+        for (uint32_t r = 0; r < rounds; r++) {
+            uint64_t t0 = now_ns();
+            for (uint32_t n = 0; n < count; n++) {
+                ptrs[n] = use_arena ? simple_arena_alloc(arena, 16) : MALLOC(16);
+            }
+            uint64_t t1 = now_ns();
+            if (use_arena) {
+                simple_arena_reset(arena);
+            } else {
+                for (uint32_t n = 0; n < count; n++) FREE(ptrs[n]);
+            }
+            uint64_t t2 = now_ns();
+            alloc_ns += t1 - t0;
+            free_ns += t2 - t1;
+        }
+        simple_arena_destroy(arena);
+
+        printf("%-8s %-12.1f %-12.2f\n", use_arena ? "arena" : "malloc",
+               alloc_ns / ((double)count * rounds), free_ns / ((double)count * rounds));
+    }
+}
+
+/**
+ * @name   bench_batch
+ * @brief  Allocation and free of many equal blocks one at a time versus in batches.
+ *
+ * Usage: bench_mm batch [blocks per batch]. Frees happen in reverse order,
+ * which the batch sorts back into address order before coalescing.
+ */
+static void bench_batch(int argc, char **argv) {
+    const uint32_t count = MAX_LIVE_BLOCKS / 4;
+    const size_t sizes[] = { 16, 64, 256 };
+    size_t batch = (argc > 1) ? strtoul(argv[1], NULL, 10) : 64;
+    if (batch == 0 || batch > count) batch = 64;
+    printf("%-8s %-8s %-12s %-12s\n", "mode", "size", "ns/alloc", "ns/free");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int batched = 0; batched <= 1; batched++) {
+            uint32_t allocated = 0;
+            uint64_t t0 = now_ns();
+            if (batched) {
+                while (allocated < count) {
+                    size_t n = (count - allocated < batch) ? count - allocated : batch;
+                    size_t got = simple_malloc_batch(sizes[s], n, ptrs + allocated);
+                    allocated += got;
+                    if (got < n) break;
+                }
+            } else {
+                while (allocated < count && (ptrs[allocated] = MALLOC(sizes[s])) != NULL) allocated++;
+            }
+            uint64_t t1 = now_ns();
+
+            // Reverse each batch-sized group so neither free path sees address order
+            for (uint32_t g = 0; g < allocated; g += batch) {
+                uint32_t lo = g, hi = (g + batch < allocated ? g + batch : allocated) - 1;
+                for (; lo < hi; lo++, hi--) {
+                    void *tmp = ptrs[lo];
+                    ptrs[lo] = ptrs[hi];
+                    ptrs[hi] = tmp;
+                }
+            }
+
+            uint64_t t2 = now_ns();
+            if (batched) {
+                for (uint32_t g = 0; g < allocated; g += batch) {
+                    simple_free_batch(ptrs + g, (g + batch < allocated) ? batch : allocated - g);
+                }
+            } else {
+                for (uint32_t n = 0; n < allocated; n++) FREE(ptrs[n]);
+            }
+            uint64_t t3 = now_ns();
+
+            if (allocated < count) printf("Only %u of %u blocks allocated\n", allocated, count);
+            printf("%-8s %-8zu %-12.1f %-12.1f\n", batched ? "batch" : "single", sizes[s],
+                   (t1 - t0) / (double)allocated, (t3 - t2) / (double)allocated);
+        }
+    }
+}
+
+/**
+ * @name   bench_small
+ * @brief  Allocation and free of tiny objects, the requests MM_SLABS serves from slabs.
+ *
+ * The span column is the address range covered by the live objects divided
+ * by their number, so it includes headers, padding and slab bitmaps.
+ */
+static void bench_small(int argc, char **argv) {
+    const uint32_t count = MAX_LIVE_BLOCKS;
+    const size_t sizes[] = { 8, 16, 24, 32, 48, 64 };
+    printf("%-8s %-12s %-12s %-12s\n", "size", "ns/alloc", "ns/free", "bytes/object");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t allocated = 0;
+        uint64_t t0 = now_ns();
+        while (allocated < count && (ptrs[allocated] = MALLOC(sizes[s])) != NULL) allocated++;
+        uint64_t t1 = now_ns();
+
+        uintptr_t low = UINTPTR_MAX, high = 0;
+        for (uint32_t n = 0; n < allocated; n++) {
+            if ((uintptr_t)ptrs[n] < low) low = (uintptr_t)ptrs[n];
+            if ((uintptr_t)ptrs[n] > high) high = (uintptr_t)ptrs[n];
+        }
+
+        uint64_t t2 = now_ns();
+        for (uint32_t n = 0; n < allocated; n++) FREE(ptrs[n]);
+        uint64_t t3 = now_ns();
+
+        if (allocated < count) printf("Only %u of %u objects allocated\n", allocated, count);
+        printf("%-8zu %-12.1f %-12.1f %-12.1f\n", sizes[s], (t1 - t0) / (double)allocated,
+               (t3 - t2) / (double)allocated, (high + sizes[s] - low) / (double)allocated);
+    }
+}
+
+#ifdef MM_THREADS
+#define PIPE_CHUNKS 8     // Chunks in flight between producer and consumer
+#define PIPE_CHUNK  1024  // Objects handed over at a time
+
+static void *pipe_objects[PIPE_CHUNKS][PIPE_CHUNK];
+static int pipe_full[PIPE_CHUNKS];  // Set by the producer, cleared by the consumer
+static uint32_t pipe_rounds;
+
+/**
+ * @name   pipe_consumer
+ * @brief  Frees every chunk of objects the producer hands over.
+ */
+static void *pipe_consumer(void *arg) {
+    for (uint32_t r = 0; r < pipe_rounds; r++) {
+        unsigned c = r % PIPE_CHUNKS;
+        while (!__atomic_load_n(&pipe_full[c], __ATOMIC_ACQUIRE)) sched_yield();
+        for (uint32_t n = 0; n < PIPE_CHUNK; n++) FREE(pipe_objects[c][n]);
+        __atomic_store_n(&pipe_full[c], 0, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/**
+ * @name   bench_pipe
+ * @brief  One thread allocates and another frees, the pattern of a producer/consumer pipeline.
+ *
+ * Every free is a cross-thread free, so this measures how much the freeing
+ * thread gets in the way of the allocating one.
+ */
+static void bench_pipe(int argc, char **argv) {
+    const size_t sizes[] = { 16, 64, 256, 1024 };
+    pipe_rounds = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1024;
+    printf("%-8s %-12s\n", "size", "ns/object");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        pthread_t consumer;
+        uint64_t t0 = now_ns();
+        pthread_create(&consumer, NULL, pipe_consumer, NULL);
+        for (uint32_t r = 0; r < pipe_rounds; r++) {
+            unsigned c = r % PIPE_CHUNKS;
+            while (__atomic_load_n(&pipe_full[c], __ATOMIC_ACQUIRE)) sched_yield();
+            for (uint32_t n = 0; n < PIPE_CHUNK; n++) {
+                pipe_objects[c][n] = MALLOC(sizes[s]);
+                if (pipe_objects[c][n] == NULL) abort();
+            }
+            __atomic_store_n(&pipe_full[c], 1, __ATOMIC_RELEASE);
+        }
+        pthread_join(consumer, NULL);
+        uint64_t t1 = now_ns();
+        printf("%-8zu %-12.1f\n", sizes[s], (t1 - t0) / ((double)pipe_rounds * PIPE_CHUNK));
+    }
+}
+
+/*
+ * Scalability workloads after larson, xmalloc and threadtest. Every thread
+ * runs the same number of operations; an operation is one malloc and one
+ * free. Each run happens in a child process, so it starts from an untouched
+ * heap and its RSS is its own.
+ */
+#define SCALE_MAX_THREADS 64
+#define SCALE_SLOTS       1024    // Live blocks per larson thread
+#define SCALE_BATCH       256     // Blocks per threadtest round and per xmalloc hand-over
+#define SCALE_ROUNDS      4       // Times larson threads pass their blocks on
+#define SCALE_SAMPLE      4096    // Operations between two RSS samples of thread 0
+
+typedef struct scale_thread {
+    pthread_t thread;
+    unsigned index;
+    uint64_t seed;
+    void **slots;                 // larson: the blocks this thread currently owns
+    void *batch[2][SCALE_BATCH];  // xmalloc: one batch being filled, the other handed over
+    void **mailbox;               // xmalloc: batch handed over by the previous thread, or NULL
+} ScaleThread;
+
+static ScaleThread scale_threads[SCALE_MAX_THREADS];
+static unsigned scale_count;                 // Threads of the current run
+static uint32_t scale_ops;                   // Operations per thread
+static unsigned scale_producing;             // xmalloc threads still allocating
+static pthread_barrier_t scale_barrier;
+static size_t scale_peak_rss;                // Largest RSS of the managed region sampled by thread 0
+static void *scale_larson_slots[SCALE_MAX_THREADS][SCALE_SLOTS];
+
+/**
+ * @name   scale_random
+ * @brief  xorshift64 step of a thread's generator.
+ */
+static uint64_t scale_random(ScaleThread *t) {
+    t->seed ^= t->seed << 13;
+    t->seed ^= t->seed >> 7;
+    t->seed ^= t->seed << 17;
+    return t->seed;
+}
+
+/**
+ * @name   scale_size
+ * @brief  Request size for a thread: mostly tiny, sometimes up to 1 KB, like larson's default range.
+ */
+static size_t scale_size(ScaleThread *t) {
+    uint64_t r = scale_random(t);
+    return (r & 3) ? 8 + (r >> 8) % 120 : 8 + (r >> 8) % 1016;
+}
+
+/**
+ * @name   region_rss
+ * @brief  Bytes of the managed region that are resident.
+ */
+static size_t region_rss(void) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = memory_start & ~(uintptr_t)(page - 1);
+    size_t pages = (__atomic_load_n(&memory_end, __ATOMIC_RELAXED) - start + page - 1) / page;
+    unsigned char *resident = malloc(pages);
+    if (resident == NULL || mincore((void *)start, pages * page, resident) != 0) {
+        free(resident);
+        return 0;
+    }
+    size_t count = 0;
+    for (size_t n = 0; n < pages; n++) count += resident[n] & 1;
+    free(resident);
+    return count * page;
+}
+
+/**
+ * @name   scale_sample
+ * @brief  Let thread 0 record the RSS of the managed region every SCALE_SAMPLE operations.
+ */
+static void scale_sample(ScaleThread *t, uint32_t op) {
+    if (t->index != 0 || op % SCALE_SAMPLE != 0) return;
+    size_t rss = region_rss();
+    if (rss > scale_peak_rss) scale_peak_rss = rss;
+}
+
+/**
+ * @name   scale_larson
+ * @brief  Replace random blocks of a set of live ones, passing the set to the next thread every round.
+ *
+ * After a hand-over each thread frees blocks another thread allocated, as
+ * the servers larson models do when a connection moves between threads.
+ */
+static void *scale_larson(void *arg) {
+    ScaleThread *t = arg;
+    for (unsigned n = 0; n < SCALE_SLOTS; n++) {
+        t->slots[n] = MALLOC(scale_size(t));
+        if (t->slots[n] == NULL) abort();
+    }
+    pthread_barrier_wait(&scale_barrier);
+
+    uint32_t op = 0;
+    for (unsigned round = 0; round < SCALE_ROUNDS; round++) {
+        for (; op < (uint64_t)scale_ops * (round + 1) / SCALE_ROUNDS; op++) {
+            unsigned n = scale_random(t) % SCALE_SLOTS;
+            FREE(t->slots[n]);
+            t->slots[n] = MALLOC(scale_size(t));
+            if (t->slots[n] == NULL) abort();
+            scale_sample(t, op);
+        }
+
+        // Everyone takes over the set of the next thread
+        pthread_barrier_wait(&scale_barrier);
+        void **next = scale_threads[(t->index + 1) % scale_count].slots;
+        pthread_barrier_wait(&scale_barrier);
+        t->slots = next;
+        pthread_barrier_wait(&scale_barrier);
+    }
+    scale_sample(t, 0);
+
+    for (unsigned n = 0; n < SCALE_SLOTS; n++) FREE(t->slots[n]);
+    return NULL;
+}
+
+/**
+ * @name   scale_drain
+ * @brief  Free the batch another thread handed to `t`, if there is one.
+ */
+static void scale_drain(ScaleThread *t) {
+    void **batch = __atomic_load_n(&t->mailbox, __ATOMIC_ACQUIRE);
+    if (batch == NULL) return;
+    for (unsigned n = 0; n < SCALE_BATCH; n++) FREE(batch[n]);
+    __atomic_store_n(&t->mailbox, NULL, __ATOMIC_RELEASE);
+}
+
+/**
+ * @name   scale_xmalloc
+ * @brief  Allocate batches and hand them to the next thread, which frees them.
+ *
+ * Every free is a cross-thread free, the producer/consumer pattern of xmalloc.
+ */
+static void *scale_xmalloc(void *arg) {
+    ScaleThread *t = arg;
+    ScaleThread *next = &scale_threads[(t->index + 1) % scale_count];
+    pthread_barrier_wait(&scale_barrier);
+
+    for (uint32_t op = 0, b = 0; op < scale_ops; op += SCALE_BATCH, b ^= 1) {
+        for (unsigned n = 0; n < SCALE_BATCH; n++) {
+            t->batch[b][n] = MALLOC(scale_size(t));
+            if (t->batch[b][n] == NULL) abort();
+        }
+        // Once the next thread took the previous batch, batch[b ^ 1] is free again
+        while (__atomic_load_n(&next->mailbox, __ATOMIC_ACQUIRE) != NULL) {
+            scale_drain(t);
+            sched_yield();
+        }
+        __atomic_store_n(&next->mailbox, t->batch[b], __ATOMIC_RELEASE);
+        scale_drain(t);
+        scale_sample(t, op);
+    }
+    scale_sample(t, 0);
+
+    __atomic_fetch_sub(&scale_producing, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&scale_producing, __ATOMIC_ACQUIRE) != 0 || __atomic_load_n(&t->mailbox, __ATOMIC_ACQUIRE) != NULL) {
+        scale_drain(t);
+        sched_yield();
+    }
+    return NULL;
+}
+
+/**
+ * @name   scale_threadtest
+ * @brief  Allocate a batch and free it again, without sharing anything with other threads.
+ */
+static void *scale_threadtest(void *arg) {
+    ScaleThread *t = arg;
+    void *batch[SCALE_BATCH];
+    pthread_barrier_wait(&scale_barrier);
+
+    for (uint32_t op = 0; op < scale_ops; op += SCALE_BATCH) {
+        for (unsigned n = 0; n < SCALE_BATCH; n++) {
+            batch[n] = MALLOC(scale_size(t));
+            if (batch[n] == NULL) abort();
+        }
+        scale_sample(t, op);
+        for (unsigned n = 0; n < SCALE_BATCH; n++) FREE(batch[n]);
+    }
+    return NULL;
+}
+
+/**
+ * @name   scale_run
+ * @brief  Run one workload on `threads` threads and print its row. Called in a child process.
+ */
+static void scale_run(const char *name, void *(*workload)(void *), unsigned threads) {
+    scale_count = threads;
+    scale_producing = threads;
+    scale_peak_rss = 0;
+    pthread_barrier_init(&scale_barrier, NULL, threads + 1);
+    for (unsigned i = 0; i < threads; i++) {
+        scale_threads[i].index = i;
+        scale_threads[i].seed = 0x9e3779b97f4a7c15ull * (i + 1);
+        scale_threads[i].slots = scale_larson_slots[i];
+        scale_threads[i].mailbox = NULL;
+        pthread_create(&scale_threads[i].thread, NULL, workload, &scale_threads[i]);
+    }
+
+    // Time from the moment every thread is ready, so setup is not counted
+    pthread_barrier_wait(&scale_barrier);
+    uint64_t t0 = now_ns();
+    if (workload == scale_larson) {
+        for (unsigned round = 0; round < SCALE_ROUNDS; round++) {
+            for (int step = 0; step < 3; step++) pthread_barrier_wait(&scale_barrier);
+        }
+    }
+    for (unsigned i = 0; i < threads; i++) pthread_join(scale_threads[i].thread, NULL);
+    uint64_t t1 = now_ns();
+    pthread_barrier_destroy(&scale_barrier);
+
+    double mops = (double)scale_ops * threads * 1000.0 / (double)(t1 - t0);
+    printf("%-12s %-8u %-10.2f %-14.2f %.1f\n", name, threads, mops, mops / threads,
+           scale_peak_rss / (1024.0 * 1024.0));
+}
+
+/**
+ * @name   bench_scale
+ * @brief  Throughput of the workloads as the number of threads grows from 1 to the number of cores.
+ *
+ * Usage: bench_mm scale [operations per thread] [maximum threads]. Thread
+ * counts double from 1, and the maximum is always run. rss is the peak
+ * resident size of the managed region, blocks mapped on their own excluded.
+ */
+static void bench_scale(int argc, char **argv) {
+    static const struct {
+        const char *name;
+        void *(*run)(void *);
+    } workloads[] = {
+        { "larson", scale_larson },
+        { "xmalloc", scale_xmalloc },
+        { "threadtest", scale_threadtest },
+    };
+    scale_ops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    scale_ops -= scale_ops % SCALE_BATCH;  // xmalloc and threadtest work in whole batches
+    if (scale_ops == 0) scale_ops = SCALE_BATCH;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned max_threads = (argc > 2) ? strtoul(argv[2], NULL, 10) : (cores > 0 ? (unsigned)cores : 1);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > SCALE_MAX_THREADS) max_threads = SCALE_MAX_THREADS;
+    printf("%-12s %-8s %-10s %-14s %s\n", "workload", "threads", "Mops/s", "Mops/s/thread", "rss MB");
+
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        for (unsigned threads = 1;; threads = (2 * threads < max_threads) ? 2 * threads : max_threads) {
+            fflush(stdout);
+            pid_t child = fork();
+            if (child == 0) {
+                scale_run(workloads[w].name, workloads[w].run, threads);
+                fflush(stdout);
+                _exit(0);
+            }
+            int status = 0;
+            if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                printf("%-12s %-8u failed\n", workloads[w].name, threads);
+            }
+            if (threads == max_threads) break;
+        }
+    }
+}
+#endif
+
+#ifdef MM_HANDLES
+#define UPTIME_MIN_SHIFT 6    // Requests range from 64 bytes...
+#define UPTIME_MAX_SHIFT 16   // ...to 64 KB, log-uniformly
+
+static SimpleHandle uptime_handles[MAX_LIVE_BLOCKS];
+static size_t uptime_sizes[MAX_LIVE_BLOCKS];
+
+/**
+ * @name   uptime_run
+ * @brief  Churn the heap at `percent` of its size with plain blocks or with handles, and print one row.
+ *
+ * Blocks are allocated while fewer than the target bytes are live and a
+ * random one is freed otherwise. A failed request frees a block instead.
+ */
+static void uptime_run(int handles, uint32_t ops, unsigned percent) {
+    const size_t target = MEMORY_MAX_SIZE / 100 * percent;
+    uint64_t seed = 0x2545f4914f6cdd1dull;
+    uint32_t live_blocks = 0, failed = 0;
+    size_t live = 0, peak_live = 0;
+
+    uint64_t t0 = now_ns();
+    for (uint32_t n = 0; n < ops; n++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        int allocate = live < target && live_blocks < MAX_LIVE_BLOCKS;
+        if (allocate) {
+            unsigned shift = UPTIME_MIN_SHIFT + seed % (UPTIME_MAX_SHIFT - UPTIME_MIN_SHIFT);
+            size_t size = ((size_t)1 << shift) + (seed >> 32) % ((size_t)1 << shift);
+            if (handles) {
+                uptime_handles[live_blocks] = simple_handle_alloc(size);
+                allocate = uptime_handles[live_blocks] != 0;
+            } else {
+                ptrs[live_blocks] = MALLOC(size);
+                allocate = ptrs[live_blocks] != NULL;
+            }
+            if (allocate) {
+                uptime_sizes[live_blocks++] = size;
+                live += size;
+                if (live > peak_live) peak_live = live;
+                continue;
+            }
+            failed++;
+        }
+        if (live_blocks == 0) continue;
+
+        uint32_t victim = (seed >> 16) % live_blocks--;
+        if (handles) {
+            simple_handle_free(uptime_handles[victim]);
+            uptime_handles[victim] = uptime_handles[live_blocks];
+        } else {
+            FREE(ptrs[victim]);
+            ptrs[victim] = ptrs[live_blocks];
+        }
+        live -= uptime_sizes[victim];
+        uptime_sizes[victim] = uptime_sizes[live_blocks];
+    }
+    uint64_t t1 = now_ns();
+
+    printf("%-10s %-10u %-10u %-14.1f %.2f\n", handles ? "handles" : "malloc", ops, failed,
+           peak_live / (1024.0 * 1024.0), ops * 1000.0 / (double)(t1 - t0));
+}
+
+/**
+ * @name   bench_uptime
+ * @brief  Allocation failures of a long-running process, with plain blocks and with relocatable ones.
+ *
+ * Usage: bench_mm uptime [operations] [percent of the heap live, default 75].
+ * Each run forks, so both start from an untouched heap. Handle requests that
+ * fail compact the heap and try again.
+ */
+static void bench_uptime(int argc, char **argv) {
+    uint32_t ops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+    unsigned percent = (argc > 2) ? strtoul(argv[2], NULL, 10) : 75;
+    printf("%-10s %-10s %-10s %-14s %s\n", "blocks", "ops", "failed", "peak live MB", "Mops/s");
+    for (int handles = 0; handles <= 1; handles++) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            uptime_run(handles, ops, percent);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("%-10s failed\n", handles ? "handles" : "malloc");
+        }
+    }
+}
+#endif
+
+/**
+ * @name   bench_realloc
+ * @brief  Growing an array one element at a time with simple_realloc.
+ *
+ * With nothing allocated behind it the array is grown by one element per
+ * append and should never move. With a small allocation after every append
+ * the array doubles its capacity instead, so it moves only O(log n) times.
+ */
+static void bench_realloc(int argc, char **argv) {
+    const uint32_t appends = MAX_LIVE_BLOCKS;
+    printf("%-10s %-12s %-12s\n", "pattern", "ns/append", "moves");
+
+    for (int blocked = 0; blocked <= 1; blocked++) {
+        uint32_t *array = NULL, capacity = 0, moves = 0;
+        uint64_t t0 = now_ns();
+        for (uint32_t n = 0; n < appends; n++) {
+            if (n == capacity) {
+                capacity = blocked ? (capacity ? 2 * capacity : 16) : capacity + 1;
+                uint32_t *grown = simple_realloc(array, capacity * sizeof(uint32_t));
+                if (grown == NULL) {
+                    printf("Realloc failed after %u appends\n", n);
+                    break;
+                }
+                moves += (array != NULL && grown != array);
+                array = grown;
+            }
+            array[n] = n;
+            if (blocked) ptrs[n] = MALLOC(8);
+        }
+        uint64_t t1 = now_ns();
+
+        FREE(array);
+        for (uint32_t n = 0; blocked && n < appends; n++) FREE(ptrs[n]);
+        printf("%-10s %-12.1f %-12u\n", blocked ? "blocked" : "free", (t1 - t0) / (double)appends, moves);
+    }
+}
+
+/* One operation of an allocation trace */
+typedef struct trace_op {
+    char op;                  // 'a' allocate, 'f' free, 'r' reallocate
+    uint32_t id;              // Identifies the block across operations
+    size_t size;              // Requested size for 'a' and 'r'
+} TraceOp;
+
+typedef struct trace {
+    TraceOp *ops;
+    size_t num_ops;
+    uint32_t num_ids;         // One more than the largest id
+} Trace;
+
+/* An allocator the traces are replayed against */
+typedef struct allocator {
+    const char *name;
+    int fit;                  // Placement policy passed to simple_set_fit, or -1
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    size_t (*footprint)(uintptr_t high_end);  // Bytes of heap the allocator holds
+} Allocator;
+
+/**
+ * @name   simple_footprint
+ * @brief  Bytes of the managed region below the end of the highest block handed out.
+ */
+static size_t simple_footprint(uintptr_t high_end) {
+    return high_end - memory_start;
+}
+
+/**
+ * @name   glibc_footprint
+ * @brief  Bytes glibc holds in its arenas and in mmapped chunks.
+ */
+static size_t glibc_footprint(uintptr_t high_end) {
+    struct mallinfo2 info = mallinfo2();
+    return info.arena + info.hblkhd;
+}
+
+static const Allocator allocators[] = {
+    { "next", MM_FIT_NEXT, simple_malloc, simple_free, simple_realloc, simple_footprint },
+    { "first", MM_FIT_FIRST, simple_malloc, simple_free, simple_realloc, simple_footprint },
+    { "best", MM_FIT_BEST, simple_malloc, simple_free, simple_realloc, simple_footprint },
+    { "good", MM_FIT_GOOD, simple_malloc, simple_free, simple_realloc, simple_footprint },
+    { "glibc", -1, malloc, free, realloc, glibc_footprint },
+};
+
+/**
+ * @name   load_trace
+ * @brief  Read a trace file with lines `a id size`, `f id` and `r id size`; `#` starts a comment.
+ * @retval 0 on success, -1 if the file cannot be read or is malformed.
+ */
+static int load_trace(const char *path, Trace *trace) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    size_t capacity = 1024;
+    trace->ops = malloc(capacity * sizeof(TraceOp));
+    trace->num_ops = 0;
+    trace->num_ids = 0;
+
+    char line[128];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        TraceOp op = { 0 };
+        unsigned long size = 0;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        int fields = sscanf(line, " %c %u %lu", &op.op, &op.id, &size);
+        if (!((op.op == 'f' && fields >= 2) || ((op.op == 'a' || op.op == 'r') && fields == 3))) {
+            fprintf(stderr, "%s:%d: malformed trace line\n", path, line_no);
+            fclose(file);
+            free(trace->ops);
+            return -1;
+        }
+        op.size = size;
+
+        if (trace->num_ops == capacity) {
+            capacity *= 2;
+            trace->ops = realloc(trace->ops, capacity * sizeof(TraceOp));
+        }
+        trace->ops[trace->num_ops++] = op;
+        if (op.id >= trace->num_ids) trace->num_ids = op.id + 1;
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @name   replay_op
+ * @brief  Apply one trace operation to `blocks` and `sizes`, indexed by id.
+ * @retval 0 on success, -1 if the allocator returned NULL.
+ */
+static int replay_op(const Allocator *allocator, const TraceOp *op, void **blocks, size_t *sizes) {
+    switch (op->op) {
+        case 'a':
+            blocks[op->id] = allocator->malloc(op->size);
+            break;
+        case 'r': {
+            void *ptr = allocator->realloc(blocks[op->id], op->size);
+            if (ptr == NULL && op->size != 0) return -1;  // The old block is still valid
+            blocks[op->id] = ptr;
+            break;
+        }
+        default:
+            allocator->free(blocks[op->id]);
+            blocks[op->id] = NULL;
+            return 0;
+    }
+    sizes[op->id] = op->size;
+    return blocks[op->id] != NULL || op->size == 0 ? 0 : -1;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @name   replay_trace
+ * @brief  Replay a trace against one allocator and print one result row.
+ *
+ * The first pass times the whole trace for throughput. The second times
+ * every operation on its own for the latency percentiles and samples the
+ * footprint between operations for the peak utilization, defined as the
+ * peak of live requested bytes over the peak footprint.
+ */
+static void replay_trace(const char *name, const Trace *trace, const Allocator *allocator) {
+    void **blocks = calloc(trace->num_ids, sizeof(void *));
+    size_t *sizes = calloc(trace->num_ids, sizeof(size_t));
+    uint32_t *latency = malloc(trace->num_ops * sizeof(uint32_t));
+    size_t failed = 0;
+    if (allocator->fit >= 0) simple_set_fit((SimpleFit)allocator->fit);
+
+    uint64_t t0 = now_ns();
+    for (size_t n = 0; n < trace->num_ops; n++) {
+        failed += replay_op(allocator, &trace->ops[n], blocks, sizes) != 0;
+    }
+    uint64_t elapsed = now_ns() - t0;
+    for (uint32_t id = 0; id < trace->num_ids; id++) {
+        allocator->free(blocks[id]);
+        blocks[id] = NULL;
+    }
+
+    size_t live = 0, peak_live = 0, peak_footprint = 0;
+    uintptr_t high_end = memory_start;
+    for (size_t n = 0; n < trace->num_ops; n++) {
+        const TraceOp *op = &trace->ops[n];
+        size_t old_size = blocks[op->id] != NULL ? sizes[op->id] : 0;
+
+        uint64_t start = now_ns();
+        replay_op(allocator, op, blocks, sizes);
+        latency[n] = (uint32_t)(now_ns() - start);
+
+        live = live - old_size + (blocks[op->id] != NULL ? sizes[op->id] : 0);
+        if (blocks[op->id] != NULL && (uintptr_t)blocks[op->id] + sizes[op->id] > high_end) {
+            high_end = (uintptr_t)blocks[op->id] + sizes[op->id];
+        }
+        size_t footprint = allocator->footprint(high_end);
+        if (live > peak_live) peak_live = live;
+        if (footprint > peak_footprint) peak_footprint = footprint;
+    }
+    for (uint32_t id = 0; id < trace->num_ids; id++) {
+        allocator->free(blocks[id]);
+    }
+
+    qsort(latency, trace->num_ops, sizeof(uint32_t), compare_u32);
+    size_t last = trace->num_ops - 1;
+    printf("%-14s %-8s %-8zu %-9.2f %-7.1f %-7u %-7u %-7u %-9u %zu\n", name, allocator->name, trace->num_ops,
+           trace->num_ops / (elapsed / 1e3), peak_footprint ? 100.0 * peak_live / peak_footprint : 0.0,
+           latency[last / 2], latency[last * 99 / 100], latency[last * 999 / 1000], latency[last], failed);
+
+    free(blocks);
+    free(sizes);
+    free(latency);
+    simple_set_fit(MM_FIT_NEXT);
+}
+
+/**
+ * @name   bench_trace
+ * @brief  Replay allocation trace files against each simple_malloc placement policy and glibc malloc.
+ */
+static void bench_trace(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: bench_mm trace FILE...\n");
+        return;
+    }
+
+    printf("%-14s %-8s %-8s %-9s %-7s %-7s %-7s %-7s %-9s %s\n", "trace", "malloc", "ops", "Mops/s",
+           "util%", "p50 ns", "p99 ns", "p99.9", "max ns", "failed");
+    for (int a = 1; a < argc; a++) {
+        Trace trace;
+        if (load_trace(argv[a], &trace) != 0) {
+            fprintf(stderr, "Cannot read trace %s\n", argv[a]);
+            continue;
+        }
+        const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a];
+        for (size_t n = 0; n < sizeof(allocators) / sizeof(allocators[0]); n++) {
+            replay_trace(name, &trace, &allocators[n]);
+        }
+        free(trace.ops);
+    }
+}
+
+/* Table of available benchmarks */
+static const struct {
+    const char *name;
+    void (*run)(int argc, char **argv);
+} benchmarks[] = {
+    { "arena", bench_arena },
+    { "batch", bench_batch },
+    { "free", bench_free },
+    { "malloc", bench_malloc },
+#ifdef MM_THREADS
+    { "pipe", bench_pipe },
+#endif
+    { "pool", bench_pool },
+    { "realloc", bench_realloc },
+#ifdef MM_THREADS
+    { "scale", bench_scale },
+#endif
+    { "small", bench_small },
+    { "trace", bench_trace },
+#ifdef MM_HANDLES
+    { "uptime", bench_uptime },
+#endif
+};
+
+#define NUM_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+/**
+ * @name   main
+ * @brief  Runs the benchmark named on the command line, or all of them.
+ * @return 0 for success, 1 if an unknown benchmark was requested.
+ */
+int main(int argc, char **argv) {
+    for (size_t b = 0; b < NUM_BENCHMARKS; b++) {
+        if (argc < 2 || strcmp(argv[1], benchmarks[b].name) == 0) {
+            printf("== %s ==\n", benchmarks[b].name);
+            benchmarks[b].run(argc - 1, argv + 1);
+            if (argc >= 2) return 0;
+        }
+    }
+
+    if (argc >= 2) {
+        fprintf(stderr, "Unknown benchmark: %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
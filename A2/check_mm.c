@@ -15,11 +15,32 @@
  * http://check.sourceforge.net/doc/check_html/check_4.html#Convenience-Test-Functions
  */
 
+#define _DEFAULT_SOURCE  // mincore
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include "mm.h"
+#include "mm_pool.h"
+#include "mm_arena.h"
+
+#if defined(MM_PROFILE) || defined(MM_RELEASE) || defined(MM_SHARED)
+#include <unistd.h>
+#endif
+
+#if defined(MM_RELEASE) || defined(MM_SHARED)
+#include <sys/mman.h>
+#endif
+
+#ifdef MM_SHARED
+#include <sys/wait.h>
+#endif
+
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
 
 /* Choose which malloc/free to test */
 #define MALLOC simple_malloc
@@ -74,6 +95,7 @@ START_TEST(test_simple_unique_addresses) {
 }
 END_TEST
 
+#ifndef MM_BUDDY
 /**
  * @name   test_non_first_fit_strategy
  * @brief  Test case to verify that the memory management system does not use the first-fit strategy.
@@ -115,6 +137,134 @@ END_TEST
 
 
 
+/**
+ * @name   test_fit_policies
+ * @brief  Tests that each placement policy picks the expected hole.
+ */
+START_TEST(test_fit_policies) {
+    uint8_t *large_hole, *small_hole, *pin1, *pin2, *ptr;
+
+    // Two holes separated by allocated blocks: a large one, then an exact fit
+    large_hole = MALLOC(2000);
+    pin1 = MALLOC(512);
+    small_hole = MALLOC(1000);
+    pin2 = MALLOC(512);
+    ck_assert(large_hole != NULL && pin1 != NULL && small_hole != NULL && pin2 != NULL);
+    FREE(large_hole);
+    FREE(small_hole);
+
+#if !defined(MM_SEGLIST) && !defined(MM_TREE)
+    // Size classes and the tree keep the two holes apart, so only the implicit list shows first-fit
+    simple_set_fit(MM_FIT_FIRST);
+    ptr = MALLOC(1000);
+    ck_assert_msg(ptr <= large_hole, "First-fit skipped the large hole");
+    FREE(ptr);
+#endif
+
+    simple_set_fit(MM_FIT_BEST);
+    ptr = MALLOC(1000);
+    ck_assert_msg(ptr == small_hole, "Best-fit did not take the exact fit");
+    FREE(ptr);
+
+    simple_set_fit(MM_FIT_GOOD);
+    ptr = MALLOC(1000);
+    ck_assert_msg(ptr == small_hole, "Good-fit did not take the exact fit");
+    FREE(ptr);
+
+    simple_set_fit(MM_FIT_NEXT);
+    FREE(pin1);
+    FREE(pin2);
+}
+END_TEST
+
+#endif
+
+#ifdef MM_QUICKLISTS
+/**
+ * @name   coalesce_deferred
+ * @brief  Make the allocator coalesce the frees it deferred, with a heap request no free block can meet.
+ *
+ * The tests share one heap, so frees deferred by earlier tests would otherwise leave holes behind.
+ */
+static void coalesce_deferred(void) {
+    size_t threshold = simple_set_mmap_threshold(0);
+    ck_assert(MALLOC(MEMORY_MAX_SIZE) == NULL);
+    simple_set_mmap_threshold(threshold);
+}
+#endif
+
+#ifdef MM_TREE
+/**
+ * @name   test_tree_best_fit
+ * @brief  Tests that the free block tree hands out the smallest hole that fits among many.
+ */
+START_TEST(test_tree_best_fit) {
+    uint8_t *holes[40], *pins[40];
+
+#ifdef MM_QUICKLISTS
+    coalesce_deferred();
+#endif
+
+    // Holes of 40 distinct sizes above the thread cache sizes, allocated in scrambled size order and kept apart by pins
+    for (int n = 0; n < 40; n++) {
+        holes[n] = MALLOC(320 + ((n * 17) % 40) * 64);
+        pins[n] = MALLOC(512);
+        ck_assert(holes[n] != NULL && pins[n] != NULL);
+    }
+    for (int n = 0; n < 40; n++) FREE(holes[n]);
+
+    // A request just below a hole's size leaves too little to split, so it must take exactly that hole
+    for (int n = 39; n >= 0; n--) {
+        uint8_t *ptr = MALLOC(320 + ((n * 17) % 40) * 64 - 8);
+        ck_assert_msg(ptr == holes[n], "Request %d got %p instead of its hole %p", n, ptr, holes[n]);
+    }
+
+    for (int n = 0; n < 40; n++) {
+        FREE(holes[n]);
+        FREE(pins[n]);
+    }
+}
+END_TEST
+
+#endif
+
+#ifdef MM_BUDDY
+/**
+ * @name   test_buddy
+ * @brief  Tests power-of-two placement, resizing within buddies and merging back to the same free blocks.
+ */
+START_TEST(test_buddy) {
+    SimpleStats before, after;
+    uintptr_t base = (memory_start + 7) & ~7;
+
+    simple_mm_stats(&before);
+
+    // A block of 2^k bytes including its header starts at a multiple of 2^k
+    uint8_t *small = MALLOC(1000);
+    uint8_t *ptr = MALLOC(4000);
+    ck_assert(small != NULL && ptr != NULL);
+    ck_assert_msg(((uintptr_t)small - 8 - base) % 1024 == 0, "Block %p not aligned to its size", small);
+    ck_assert_msg(((uintptr_t)ptr - 8 - base) % 4096 == 0, "Block %p not aligned to its size", ptr);
+
+    // Shrinking frees the upper halves, and growing takes them back without moving
+    for (int n = 0; n < 500; n++) ptr[n] = (uint8_t)n;
+    ck_assert(simple_realloc(ptr, 500) == ptr);
+    ck_assert(simple_realloc(ptr, 4000) == ptr);
+    for (int n = 0; n < 500; n++) ck_assert(ptr[n] == (uint8_t)n);
+
+    // Merging is canonical: with the same blocks allocated, the same free blocks remain
+    FREE(small);
+    FREE(ptr);
+    simple_mm_stats(&after);
+    ck_assert(after.blocks_in_use == before.blocks_in_use);
+    ck_assert_msg(after.blocks_free == before.blocks_free, "%zu free blocks, expected %zu",
+                  after.blocks_free, before.blocks_free);
+    ck_assert(after.largest_free == before.largest_free);
+}
+END_TEST
+
+#endif
+
 /**
  * @name   test_memory_exerciser
  * @brief  Allocates and deallocates varying sizes of memory blocks to check for alignment and corruption.
@@ -211,6 +361,892 @@ START_TEST(test_memory_exerciser) {
 }
 END_TEST
 
+#ifndef MM_BUDDY
+/**
+ * @name   test_realloc
+ * @brief  Tests in-place growth into a free successor, in-place shrinking and moving when blocked.
+ */
+START_TEST(test_realloc) {
+    uint8_t *ptr1, *ptr2, *blocker;
+
+    ptr1 = MALLOC(1000);
+    ck_assert(ptr1 != NULL);
+    for (int n = 0; n < 1000; n++) ptr1[n] = (uint8_t)n;
+
+    // Freeing the successor lets the block grow without moving
+    blocker = MALLOC(3000);
+    ck_assert(blocker != NULL);
+    FREE(blocker);
+    ptr2 = simple_realloc(ptr1, 2000);
+    ck_assert_msg(ptr2 == ptr1, "Block moved although its successor was free");
+
+    // Shrinking never moves the block
+    ptr2 = simple_realloc(ptr1, 600);
+    ck_assert(ptr2 == ptr1);
+
+    // With an allocated successor the contents have to be copied
+    blocker = MALLOC(3000);
+    ck_assert(blocker != NULL);
+    ck_assert((uintptr_t)blocker <= (uintptr_t)ptr1 + 2000);
+    ptr2 = simple_realloc(ptr1, 5000);
+    ck_assert(ptr2 != NULL);
+    for (int n = 0; n < 600; n++) {
+        ck_assert_msg(ptr2[n] == (uint8_t)n, "Byte %d lost by realloc", n);
+    }
+
+    ck_assert(simple_realloc(ptr2, 0) == NULL);
+    FREE(blocker);
+}
+END_TEST
+
+#endif
+
+/**
+ * @name   test_memalign
+ * @brief  Tests that aligned blocks are aligned and do not overlap their neighbours.
+ */
+START_TEST(test_memalign) {
+    size_t alignments[] = { 8, 16, 64, 4096, 65536 };
+
+    for (size_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++) {
+        uint8_t *before = MALLOC(24);
+        uint8_t *ptr = simple_memalign(alignments[a], 1000);
+        uint8_t *after = MALLOC(24);
+        ck_assert(before != NULL && ptr != NULL && after != NULL);
+        ck_assert_msg(((uintptr_t)ptr & (alignments[a] - 1)) == 0, "Address %p not aligned to %zu", ptr, alignments[a]);
+        size_t usable = simple_usable_size(ptr);
+        ck_assert(usable >= 1000 && simple_usable_size(before) >= 24);
+
+        // The aligned block, up to its usable size, must not overlap its neighbours
+        for (int n = 0; n < 24; n++) before[n] = after[n] = 0x5a;
+        for (size_t n = 0; n < usable; n++) ptr[n] = 0xa5;
+        for (int n = 0; n < 24; n++) ck_assert(before[n] == 0x5a && after[n] == 0x5a);
+
+        FREE(before);
+        FREE(ptr);
+        FREE(after);
+    }
+
+    ck_assert(simple_memalign(48, 100) == NULL);  // Not a power of two
+    ck_assert(simple_usable_size(NULL) == 0);
+}
+END_TEST
+
+/**
+ * @name   test_calloc
+ * @brief  Tests that calloc returns zeroed memory both for reused and for fresh blocks.
+ */
+START_TEST(test_calloc) {
+    // Dirty a block, free it and ask for the same size again
+    uint8_t *dirty = MALLOC(4000);
+    ck_assert(dirty != NULL);
+    for (int n = 0; n < 4000; n++) dirty[n] = 0xff;
+    FREE(dirty);
+
+    uint8_t *ptr = simple_calloc(1000, 4);
+    ck_assert(ptr != NULL);
+    for (int n = 0; n < 4000; n++) {
+        ck_assert_msg(ptr[n] == 0, "Byte %d of calloc block is %02x", n, ptr[n]);
+    }
+
+    // A large block reaching far past anything allocated before
+    uint8_t *big = simple_calloc(4 * 1024, 1024);
+    ck_assert(big != NULL);
+    for (int n = 0; n < 4 * 1024 * 1024; n++) {
+        ck_assert_msg(big[n] == 0, "Byte %d of calloc block is %02x", n, big[n]);
+    }
+
+    ck_assert(simple_calloc(SIZE_MAX / 2, 4) == NULL);  // Overflow
+
+#ifdef MM_GROWABLE
+    // Grow once to leave a free tail that was never written, then grow across it with calloc:
+    // the old sentinel and the footer before it end up inside the new block
+    SimpleStats stats;
+    size_t threshold = simple_set_mmap_threshold(0);
+    simple_mm_stats(&stats);
+    uint8_t *low = MALLOC(stats.largest_free + 8);
+    simple_mm_stats(&stats);
+    uintptr_t old_end = memory_end;
+    size_t size = stats.largest_free + 8;
+    uint8_t *grown = simple_calloc(1, size);
+    ck_assert(low != NULL && grown != NULL && memory_end > old_end);
+    for (uintptr_t at = old_end - 64; at < old_end + 64; at++) {
+        if (at < (uintptr_t)grown || at >= (uintptr_t)grown + size) continue;
+        ck_assert_msg(*(uint8_t *)at == 0, "Byte at old end %+d is %02x", (int)(at - old_end), *(uint8_t *)at);
+    }
+    FREE(grown);
+    FREE(low);
+    simple_set_mmap_threshold(threshold);
+#endif
+
+    FREE(ptr);
+    FREE(big);
+}
+END_TEST
+
+/**
+ * @name   heap_bytes
+ * @brief  Bytes covered by all blocks of a stats snapshot, including their headers.
+ */
+static size_t heap_bytes(SimpleStats *stats) {
+    return stats->bytes_in_use + stats->bytes_free + (stats->blocks_in_use + stats->blocks_free) * sizeof(void *);
+}
+
+/**
+ * @name   test_stats
+ * @brief  Tests that the heap statistics follow allocations, frees and searches.
+ */
+START_TEST(test_stats) {
+    SimpleStats before, after;
+    uint64_t searches_before = 0, searches_after = 0;
+
+#ifdef MM_QUICKLISTS
+    coalesce_deferred();
+#endif
+    simple_mm_stats(&before);
+    void *ptr1 = MALLOC(1000);
+    void *ptr2 = MALLOC(2000);
+    void *ptr3 = MALLOC(3000);
+    ck_assert(ptr1 != NULL && ptr2 != NULL && ptr3 != NULL);
+    FREE(ptr2);
+    simple_mm_stats(&after);
+
+    ck_assert_msg(after.blocks_in_use == before.blocks_in_use + 2, "%zu blocks in use, expected %zu",
+                  after.blocks_in_use, before.blocks_in_use + 2);
+#ifdef MM_BUDDY
+    ck_assert(after.bytes_in_use >= before.bytes_in_use + 4000);  // Rounded up to powers of two
+#else
+    ck_assert(after.bytes_in_use == before.bytes_in_use + 4000);
+#endif
+    ck_assert_msg(heap_bytes(&after) == heap_bytes(&before), "Heap size changed from %zu to %zu",
+                  heap_bytes(&before), heap_bytes(&after));
+    ck_assert(after.largest_free <= after.bytes_free);
+    ck_assert(after.fragmentation >= 0.0 && after.fragmentation < 1.0);
+    ck_assert(after.splits >= before.splits + 3);
+
+    for (int b = 0; b < MM_SEARCH_BUCKETS; b++) {
+        searches_before += before.search_histogram[b];
+        searches_after += after.search_histogram[b];
+    }
+    ck_assert(searches_after == searches_before + 3);
+
+    FREE(ptr1);
+    FREE(ptr3);
+    simple_mm_stats(&after);
+    ck_assert(after.coalesces >= before.coalesces + 2);
+    ck_assert(after.blocks_in_use == before.blocks_in_use);
+}
+END_TEST
+
+#ifdef MM_GROWABLE
+/**
+ * @name   test_heap_growth
+ * @brief  Tests that the heap grows past its initial size and stays usable.
+ */
+START_TEST(test_heap_growth) {
+    uint32_t *blocks[6];
+    size_t size = 16 * 1024 * 1024;
+    size_t threshold = simple_set_mmap_threshold(0);  // Keep the blocks in the heap rather than in mappings of their own
+
+    // 96 MB in total, well beyond the old fixed region
+    for (int n = 0; n < 6; n++) {
+        blocks[n] = MALLOC(size);
+        ck_assert_msg(blocks[n] != NULL, "Allocation %d failed to grow the heap", n);
+        blocks[n][0] = n;
+        blocks[n][size / 4 - 1] = n;
+    }
+    ck_assert(memory_end - memory_start >= 6 * size);
+
+    for (int n = 0; n < 6; n++) {
+        ck_assert(blocks[n][0] == (uint32_t)n && blocks[n][size / 4 - 1] == (uint32_t)n);
+        FREE(blocks[n]);
+    }
+
+    // The grown memory coalesced into one block
+    void *big = MALLOC(6 * size);
+    ck_assert(big != NULL);
+    FREE(big);
+    simple_set_mmap_threshold(threshold);
+}
+END_TEST
+
+#endif
+
+#ifndef MM_SHARED
+/**
+ * @name   test_mmap_threshold
+ * @brief  Tests that requests above the threshold are mapped outside the heap and unmapped on free.
+ */
+START_TEST(test_mmap_threshold) {
+    SimpleStats stats;
+    size_t threshold = simple_set_mmap_threshold(1024 * 1024);
+
+    uint8_t *small = MALLOC(1000);
+    uint8_t *large = MALLOC(4 * 1024 * 1024);
+    ck_assert(small != NULL && large != NULL);
+    ck_assert((uintptr_t)small >= memory_start && (uintptr_t)small < memory_end);
+    ck_assert_msg((uintptr_t)large < memory_start || (uintptr_t)large >= memory_end,
+                  "Large block %p was carved out of the heap", large);
+    ck_assert(((uintptr_t)large & 0x07) == 0);
+
+    simple_mm_stats(&stats);
+    ck_assert(stats.mmapped_blocks == 1);
+    ck_assert(stats.mmapped_bytes >= 4 * 1024 * 1024);
+
+    // Growing a mapped block keeps its contents
+    for (int n = 0; n < 4 * 1024 * 1024; n += 4096) large[n] = (uint8_t)(n >> 12);
+    large = simple_realloc(large, 8 * 1024 * 1024);
+    ck_assert(large != NULL);
+    for (int n = 0; n < 4 * 1024 * 1024; n += 4096) ck_assert(large[n] == (uint8_t)(n >> 12));
+
+    uint32_t *zeroed = simple_calloc(1024, 1024);
+    ck_assert(zeroed != NULL);
+    for (int n = 0; n < 256 * 1024; n++) ck_assert(zeroed[n] == 0);
+
+    FREE(large);
+    FREE(zeroed);
+    FREE(small);
+    simple_mm_stats(&stats);
+    ck_assert(stats.mmapped_blocks == 0 && stats.mmapped_bytes == 0);
+
+    simple_set_mmap_threshold(threshold);
+}
+END_TEST
+#endif
+
+/**
+ * @name   test_pool_allocation
+ * @brief  Tests that pool objects are distinct, aligned, reused after free and released on destroy or reset.
+ */
+START_TEST(test_pool_allocation) {
+    void *objects[1000];
+    SimplePool *pool = simple_pool_create(12);
+    ck_assert(pool != NULL);
+
+    for (int n = 0; n < 1000; n++) {
+        objects[n] = simple_pool_alloc(pool);
+        ck_assert(objects[n] != NULL);
+        ck_assert_msg(((uintptr_t)objects[n] & 0x07) == 0, "Unaligned address %p returned!", objects[n]);
+        *(uint32_t *)objects[n] = n;
+    }
+
+    // Objects must not overlap: every one still holds its own index
+    for (int n = 0; n < 1000; n++) {
+        ck_assert(*(uint32_t *)objects[n] == (uint32_t)n);
+    }
+
+    // A freed slot is handed out again by the next allocation
+    simple_pool_free(pool, objects[500]);
+    ck_assert(simple_pool_alloc(pool) == objects[500]);
+
+    simple_pool_destroy(pool);
+
+    // The slabs went back to the heap
+    void *big = MALLOC(24 * 1024 * 1024);
+    ck_assert(big != NULL);
+    FREE(big);
+
+    // With slabs from an arena, resetting both starts over at the same first slot
+    SimpleArena *arena = simple_arena_create();
+    ck_assert(arena != NULL);
+    pool = simple_pool_create_in(arena, 12);
+    ck_assert(pool != NULL);
+    for (int n = 0; n < 1000; n++) ck_assert((objects[n] = simple_pool_alloc(pool)) != NULL);
+    simple_pool_free(pool, objects[10]);
+    simple_arena_reset(arena);
+    simple_pool_reset(pool);
+    ck_assert(simple_pool_alloc(pool) == objects[0]);
+    simple_pool_destroy(pool);
+    simple_arena_destroy(arena);
+}
+END_TEST
+
+/**
+ * @name   test_arena
+ * @brief  Tests that arena memory is aligned and distinct, and that restore and reset free it for reuse.
+ */
+START_TEST(test_arena) {
+    void *objects[1000];
+    SimpleStats before, after;
+    simple_mm_stats(&before);
+
+    SimpleArena *arena = simple_arena_create();
+    ck_assert(arena != NULL);
+    for (int n = 0; n < 1000; n++) {
+        objects[n] = simple_arena_alloc(arena, 4 + n % 100);
+        ck_assert(objects[n] != NULL);
+        ck_assert_msg(((uintptr_t)objects[n] & 0x07) == 0, "Unaligned address %p returned!", objects[n]);
+        *(uint32_t *)objects[n] = n;
+    }
+    for (int n = 0; n < 1000; n++) {
+        ck_assert(*(uint32_t *)objects[n] == (uint32_t)n);
+    }
+
+    // Restoring a mark hands out the same memory again, across chunks and for nested marks
+    SimpleArenaMark outer = simple_arena_save(arena);
+    void *first = simple_arena_alloc(arena, 24);
+    SimpleArenaMark inner = simple_arena_save(arena);
+    void *second = simple_arena_alloc(arena, 24);
+    ck_assert(simple_arena_alloc(arena, 200 * 1024) != NULL);  // Larger than a chunk
+    for (int n = 0; n < 10000; n++) ck_assert(simple_arena_alloc(arena, 16) != NULL);
+    simple_arena_restore(arena, inner);
+    ck_assert(simple_arena_alloc(arena, 24) == second);
+    simple_arena_restore(arena, outer);
+    ck_assert(simple_arena_alloc(arena, 24) == first);
+    ck_assert(*(uint32_t *)objects[999] == 999);
+
+    // After a reset the arena starts over in the chunks it already has
+    simple_mm_stats(&after);
+    size_t blocks = after.blocks_in_use;
+    simple_arena_reset(arena);
+    for (int n = 0; n < 1000; n++) ck_assert(simple_arena_alloc(arena, 4 + n % 100) != NULL);
+    simple_mm_stats(&after);
+    ck_assert(after.blocks_in_use == blocks);
+
+    // Only the arena itself may stay behind, in a thread cache or slab
+    simple_arena_destroy(arena);
+    simple_mm_stats(&after);
+    ck_assert_msg(after.bytes_in_use < before.bytes_in_use + 16 * 1024, "%zu bytes not returned",
+                  after.bytes_in_use - before.bytes_in_use);
+}
+END_TEST
+
+/**
+ * @name   test_batch
+ * @brief  Tests that a batch is allocated back to back and freed as one, in any order.
+ */
+START_TEST(test_batch) {
+    void *blocks[500];
+    SimpleStats before, after;
+
+    simple_mm_stats(&before);
+    ck_assert(simple_malloc_batch(300, 500, blocks) == 500);
+    for (int n = 0; n < 500; n++) {
+        ck_assert(blocks[n] != NULL);
+        ck_assert_msg(((uintptr_t)blocks[n] & 0x07) == 0, "Unaligned address %p returned!", blocks[n]);
+        memset(blocks[n], n & 0xff, 300);
+    }
+    for (int n = 0; n < 500; n++) {
+        for (int i = 0; i < 300; i++) ck_assert(((uint8_t *)blocks[n])[i] == (uint8_t)(n & 0xff));
+    }
+
+    // Blocks cut from one free block follow each other in the heap
+    int adjacent = 0;
+    for (int n = 1; n < 500; n++) {
+        if ((uintptr_t)blocks[n] > (uintptr_t)blocks[n - 1]) adjacent++;
+    }
+    ck_assert_msg(adjacent >= 490, "Only %d of 499 blocks follow their predecessor", adjacent);
+
+    simple_mm_stats(&after);
+    ck_assert(after.blocks_in_use == before.blocks_in_use + 500);
+
+    // Free in shuffled order, with a NULL entry and a block freed on its own (too large for a thread cache)
+    for (int n = 499; n > 0; n--) {
+        int k = (n * 7919) % (n + 1);
+        void *tmp = blocks[n];
+        blocks[n] = blocks[k];
+        blocks[k] = tmp;
+    }
+    FREE(blocks[250]);
+    blocks[250] = NULL;
+    simple_free_batch(blocks, 500);
+
+    simple_mm_stats(&after);
+    ck_assert(after.blocks_in_use == before.blocks_in_use);
+    ck_assert_msg(heap_bytes(&after) == heap_bytes(&before), "Heap size changed from %zu to %zu",
+                  heap_bytes(&before), heap_bytes(&after));
+}
+END_TEST
+
+#ifdef MM_HANDLES
+/**
+ * @name   test_handles
+ * @brief  Compaction slides unpinned handle blocks over the holes before them and keeps their contents.
+ */
+START_TEST(test_handles) {
+    SimpleHandle handles[200];
+    uint8_t *pinned_before = NULL;
+    SimpleStats before, after;
+
+    // 200 blocks of 1000 bytes, every other one freed, leaving holes between live blocks
+    for (int n = 0; n < 200; n++) {
+        handles[n] = simple_handle_alloc(1000);
+        ck_assert(handles[n] != 0);
+        uint8_t *ptr = simple_handle_pin(handles[n]);
+        ck_assert(ptr != NULL);
+        ck_assert_msg(((uintptr_t)ptr & 0x07) == 0, "Unaligned address %p returned!", ptr);
+        memset(ptr, n & 0xff, 1000);
+        simple_handle_unpin(handles[n]);
+    }
+    for (int n = 0; n < 200; n += 2) simple_handle_free(handles[n]);
+    ck_assert(simple_handle_pin(handles[0]) == NULL);
+
+    // A pinned block stays where it is
+    pinned_before = simple_handle_pin(handles[101]);
+#ifdef MM_QUICKLISTS
+    coalesce_deferred();  // Compaction flushes the quick lists, which would change bytes_in_use below
+#endif
+    simple_mm_stats(&before);
+    ck_assert(simple_handle_compact(0) > 0);
+    simple_mm_stats(&after);
+    ck_assert(simple_handle_pin(handles[101]) == pinned_before);
+    simple_handle_unpin(handles[101]);
+    simple_handle_unpin(handles[101]);
+
+    // The holes merged into fewer, larger free blocks
+    ck_assert_msg(after.blocks_free < before.blocks_free, "%zu free blocks before compaction, %zu after",
+                  before.blocks_free, after.blocks_free);
+    ck_assert(after.largest_free > before.largest_free || after.largest_free == after.bytes_free);
+    ck_assert(after.bytes_in_use == before.bytes_in_use);
+
+    for (int n = 1; n < 200; n += 2) {
+        uint8_t *ptr = simple_handle_pin(handles[n]);
+        ck_assert(ptr != NULL);
+        for (int i = 0; i < 1000; i++) ck_assert_msg(ptr[i] == (uint8_t)(n & 0xff), "Handle %d lost byte %d", n, i);
+        simple_handle_unpin(handles[n]);
+        simple_handle_free(handles[n]);
+    }
+}
+END_TEST
+#endif
+
+#ifdef MM_QUICKLISTS
+/**
+ * @name   test_quicklists
+ * @brief  Freed small blocks are reused by size without coalescing, until a request finds no free block.
+ */
+START_TEST(test_quicklists) {
+    SimpleStats before, after;
+    void *blocks[64];
+
+    // Ping-pong on one size takes the same block back without splitting or coalescing
+    void *ptr = MALLOC(100);
+    ck_assert(ptr != NULL);
+    simple_mm_stats(&before);
+    for (int n = 0; n < 1000; n++) {
+        FREE(ptr);
+        void *again = MALLOC(100);
+        ck_assert_msg(again == ptr, "Round %d got %p instead of %p", n, again, ptr);
+    }
+    simple_mm_stats(&after);
+    ck_assert(after.coalesces == before.coalesces);
+    ck_assert(after.splits == before.splits);
+    FREE(ptr);
+
+    // Adjacent freed blocks wait apart from each other
+    for (int n = 0; n < 64; n++) {
+        blocks[n] = MALLOC(200);
+        ck_assert(blocks[n] != NULL);
+    }
+    simple_mm_stats(&before);
+    for (int n = 0; n < 64; n++) FREE(blocks[n]);
+    simple_mm_stats(&after);
+#ifdef MM_THREADS
+    ck_assert(after.quick_blocks >= before.quick_blocks + 32);  // The thread cache keeps the rest
+#else
+    ck_assert(after.quick_blocks == before.quick_blocks + 64);
+#endif
+    ck_assert(after.blocks_in_use == before.blocks_in_use);
+    ck_assert(after.coalesces == before.coalesces);
+
+    // A request no free block can meet coalesces them first
+    coalesce_deferred();
+    simple_mm_stats(&after);
+    ck_assert(after.quick_blocks == 0);
+    ck_assert(after.coalesces > before.coalesces);
+}
+END_TEST
+#endif
+
+#ifdef MM_SHARED
+/* A list node as processes share it: the heap may be mapped anywhere, so links are offsets */
+typedef struct shared_node {
+    uint64_t next;
+    uint64_t value;
+    uintptr_t address;        // Where the producer saw the node
+} SharedNode;
+
+/**
+ * @name   shared_build
+ * @brief  Publish a list of `count` nodes holding 0..count-1 as the root of the heap.
+ * @retval 0 on success, -1 if the heap is full.
+ */
+static int shared_build(uint64_t count) {
+    uint64_t head = 0;
+    for (uint64_t n = count; n-- > 0;) {
+        SharedNode *node = MALLOC(sizeof(SharedNode));
+        if (node == NULL) return -1;
+        node->next = head;
+        node->value = n;
+        node->address = (uintptr_t)node;
+        head = simple_shared_offset(node);
+    }
+    simple_shared_set_root(simple_shared_pointer(head));
+    return 0;
+}
+
+/**
+ * @name   shared_consume
+ * @brief  Check and free the published list.
+ * @retval Its length, or -1 if a value is wrong or `moved` and a node is where the producer saw it.
+ */
+static long shared_consume(int moved) {
+    long count = 0;
+    SharedNode *node = simple_shared_root();
+    simple_shared_set_root(NULL);
+    while (node != NULL) {
+        if (node->value != (uint64_t)count || (moved && node->address == (uintptr_t)node)) return -1;
+        SharedNode *next = simple_shared_pointer(node->next);
+        FREE(node);
+        node = next;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @name   shared_wait
+ * @brief  Wait for a child process. Returns its exit status, or -1 if it did not exit normally.
+ */
+static int shared_wait(pid_t child) {
+    int status = 0;
+    if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+/**
+ * @name   test_shared
+ * @brief  Processes allocate and free in one heap and pass a list through it without copying.
+ */
+START_TEST(test_shared) {
+    SimpleStats before, after;
+    simple_mm_stats(&before);
+
+    // A forked child frees the list of its parent and hands back one of its own
+    ck_assert(shared_build(1000) == 0);
+    pid_t child = fork();
+    if (child == 0) _exit((shared_consume(0) == 1000 && shared_build(500) == 0) ? 0 : 1);
+    ck_assert(shared_wait(child) == 0);
+    ck_assert(shared_consume(0) == 500);
+    simple_mm_stats(&after);
+    ck_assert(after.blocks_in_use == before.blocks_in_use);
+
+    // A producer and a consumer attach a named heap at different addresses
+    char name[64];
+    int base_pipe[2];
+    uintptr_t base = 0;
+    snprintf(name, sizeof(name), "/simple_mm_check.%d", (int)getpid());
+    ck_assert(pipe(base_pipe) == 0);
+    child = fork();
+    if (child == 0) {
+        simple_shared_detach();
+        if (simple_shared_attach(name, 1024 * 1024) != 0 || shared_build(1000) != 0) _exit(1);
+        _exit(write(base_pipe[1], &memory_start, sizeof(memory_start)) == sizeof(memory_start) ? 0 : 1);
+    }
+    ck_assert(shared_wait(child) == 0);
+    ck_assert(read(base_pipe[0], &base, sizeof(base)) == sizeof(base));
+    close(base_pipe[0]);
+    close(base_pipe[1]);
+    child = fork();
+    if (child == 0) {
+        simple_shared_detach();
+        // Occupy the address the producer had, so the consumer maps the heap elsewhere
+        mmap((void *)base, 1024 * 1024, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        _exit((simple_shared_attach(name, 0) == 0 && shared_consume(1) == 1000) ? 0 : 1);
+    }
+    ck_assert(shared_wait(child) == 0);
+    ck_assert(shm_unlink(name) == 0);
+}
+END_TEST
+#endif
+
+#ifdef MM_RELEASE
+/**
+ * @name   resident_pages
+ * @brief  Number of the whole pages in [ptr, ptr + size) that are resident.
+ */
+static size_t resident_pages(void *ptr, size_t size) {
+    static unsigned char vec[MEMORY_MAX_SIZE / 4096];
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)ptr + size) & ~(page - 1);
+    if (end <= start) return 0;
+    if ((end - start) / page > sizeof(vec) || mincore((void *)start, end - start, vec) != 0) return SIZE_MAX;
+
+    size_t resident = 0;
+    for (size_t n = 0; n < (end - start) / page; n++) resident += vec[n] & 1;
+    return resident;
+}
+
+/**
+ * @name   test_release
+ * @brief  Freeing a large block gives its pages back, unless the same memory keeps coming back.
+ */
+START_TEST(test_release) {
+    SimpleStats before, after;
+    size_t threshold = simple_set_mmap_threshold(0);
+    size_t release_threshold = simple_set_release_threshold(0);
+
+    // The pages of a large block are gone once it is freed, except at the edges
+#ifdef MM_HUGEPAGES
+    size_t unit = 2 * 1024 * 1024, size = 8 * 1024 * 1024;
+#else
+    size_t unit = 4096, size = 1024 * 1024;
+#endif
+    simple_mm_stats(&before);
+    char *ptr = MALLOC(size);
+    ck_assert(ptr != NULL);
+    memset(ptr, 0x5a, size);
+    ck_assert(resident_pages(ptr, size) == size / 4096 - 1);
+    FREE(ptr);
+    simple_mm_stats(&after);
+    ck_assert(after.released_bytes >= before.released_bytes + size / 2);
+    ck_assert(resident_pages(ptr + unit, size - 2 * unit) == 0);
+
+    // Taking the same pages back straight away raises the threshold, which ends the cycle
+    simple_mm_stats(&before);
+    for (int n = 0; n < 8; n++) {
+        ptr = MALLOC(size);
+        ck_assert(ptr != NULL);
+        memset(ptr, 0x5a, size);
+        FREE(ptr);
+    }
+    simple_mm_stats(&after);
+    ck_assert(after.release_threshold > size / 2);
+    ck_assert(after.released_bytes < before.released_bytes + 4 * size);
+
+    simple_set_release_threshold(release_threshold);
+    simple_set_mmap_threshold(threshold);
+}
+END_TEST
+#endif
+
+#ifdef MM_PROFILE
+/**
+ * @name   profile_counts
+ * @brief  Write the profile and read back the requests and frees counted for `size`.
+ */
+static void profile_counts(size_t size, unsigned long long *requests, unsigned long long *frees) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/check_mm_profile.%d", (int)getpid());
+    ck_assert(simple_mm_profile_write(path) == 0);
+
+    FILE *file = fopen(path, "r");
+    ck_assert(file != NULL);
+    char line[256];
+    unsigned long long line_size, lifetime;
+    *requests = *frees = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%llu %llu %llu %llu", &line_size, requests, frees, &lifetime) == 4 && line_size == size) break;
+        *requests = *frees = 0;
+    }
+    fclose(file);
+    unlink(path);
+}
+
+/**
+ * @name   test_profile
+ * @brief  Requests are counted by size, rounded up to 8 bytes, and frees by the size they were requested with.
+ */
+START_TEST(test_profile) {
+    unsigned long long requests_before, frees_before, requests, frees;
+    void *blocks[100];
+
+    profile_counts(1000, &requests_before, &frees_before);
+    for (int n = 0; n < 100; n++) {
+        blocks[n] = MALLOC(993 + n % 8);
+        ck_assert(blocks[n] != NULL);
+    }
+    for (int n = 0; n < 60; n++) FREE(blocks[n]);
+
+    profile_counts(1000, &requests, &frees);
+    ck_assert_msg(requests == requests_before + 100, "%llu requests of 1000 bytes counted", requests - requests_before);
+    ck_assert_msg(frees == frees_before + 60, "%llu frees of 1000 bytes counted", frees - frees_before);
+
+    // A realloc counts as a free of the old size and a request of the new one
+    blocks[60] = simple_realloc(blocks[60], 3000);
+    ck_assert(blocks[60] != NULL);
+    profile_counts(1000, &requests, &frees);
+    ck_assert(frees == frees_before + 61);
+    for (int n = 60; n < 100; n++) FREE(blocks[n]);
+}
+END_TEST
+#endif
+
+#ifdef MM_SLABS
+/**
+ * @name   test_slabs
+ * @brief  Tiny blocks are packed headerless into slabs, which go back to the heap once empty.
+ */
+START_TEST(test_slabs) {
+    void *objects[2000];
+    SimpleStats before, after;
+
+    simple_mm_stats(&before);
+    for (int n = 0; n < 2000; n++) {
+        objects[n] = MALLOC(24);
+        ck_assert(objects[n] != NULL);
+        ck_assert_msg(((uintptr_t)objects[n] & 0x07) == 0, "Unaligned address %p returned!", objects[n]);
+        memset(objects[n], n & 0xff, 24);
+    }
+
+    // Objects of a slab follow each other without a header in between
+    int packed = 0;
+    for (int n = 1; n < 2000; n++) {
+        if ((uintptr_t)objects[n] == (uintptr_t)objects[n - 1] + 24) packed++;
+    }
+    ck_assert_msg(packed >= 1950, "Only %d of 1999 objects directly follow their predecessor", packed);
+
+    simple_mm_stats(&after);
+    ck_assert(after.slab_objects == before.slab_objects + 2000);
+    ck_assert(after.slabs > before.slabs);
+
+    for (int n = 0; n < 2000; n++) {
+        for (int i = 0; i < 24; i++) ck_assert(((uint8_t *)objects[n])[i] == (uint8_t)(n & 0xff));
+    }
+
+    // A freed slot is the next one handed out
+    FREE(objects[1000]);
+    void *again = MALLOC(20);
+    ck_assert(again == objects[1000]);
+    objects[1000] = again;
+
+    for (int n = 0; n < 2000; n++) FREE(objects[n]);
+    simple_mm_stats(&after);
+    ck_assert(after.slab_objects == before.slab_objects);
+    ck_assert_msg(after.slabs <= before.slabs + 1, "%zu empty slabs kept", after.slabs - before.slabs);
+}
+END_TEST
+#endif
+
+#ifdef MM_THREADS
+#define THREADS           4
+#define BLOCKS_PER_THREAD 2000
+
+static uint8_t *thread_blocks[THREADS][BLOCKS_PER_THREAD];
+
+/**
+ * @name   thread_size
+ * @brief  Size of block n of a thread, mixing cached and heap-served sizes.
+ */
+static size_t thread_size(uint32_t n) {
+    return (n % 7 == 0) ? 1000 + n : 8 + (n % 40) * 8;
+}
+
+/**
+ * @name   thread_allocate
+ * @brief  Allocates the blocks of one thread and fills them with its id.
+ */
+static void *thread_allocate(void *arg) {
+    uintptr_t t = (uintptr_t)arg;
+    for (uint32_t n = 0; n < BLOCKS_PER_THREAD; n++) {
+        thread_blocks[t][n] = MALLOC(thread_size(n));
+        if (thread_blocks[t][n] != NULL) {
+            for (size_t i = 0; i < thread_size(n); i++) thread_blocks[t][n][i] = (uint8_t)t;
+        }
+        // Churn the calling thread's own cache as well
+        FREE(MALLOC(thread_size(n + 1)));
+    }
+    return NULL;
+}
+
+/**
+ * @name   thread_free_neighbour
+ * @brief  Frees the blocks allocated by the next thread.
+ */
+static void *thread_free_neighbour(void *arg) {
+    uintptr_t t = ((uintptr_t)arg + 1) % THREADS;
+    for (uint32_t n = 0; n < BLOCKS_PER_THREAD; n++) {
+        FREE(thread_blocks[t][n]);
+    }
+    return NULL;
+}
+
+/**
+ * @name   test_threads_cross_free
+ * @brief  Allocates from several threads at once and frees every block from a different thread.
+ */
+START_TEST(test_threads_cross_free) {
+    pthread_t threads[THREADS];
+
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, thread_allocate, (void *)t);
+    }
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // Every block must be present and still hold the id of the thread that wrote it
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        for (uint32_t n = 0; n < BLOCKS_PER_THREAD; n++) {
+            ck_assert_msg(thread_blocks[t][n] != NULL, "Allocation %u of thread %u failed", n, (unsigned)t);
+            for (size_t i = 0; i < thread_size(n); i++) {
+                ck_assert_msg(thread_blocks[t][n][i] == t, "Block %u of thread %u was overwritten", n, (unsigned)t);
+            }
+        }
+    }
+
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, thread_free_neighbour, (void *)t);
+    }
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // The exiting threads have handed their caches back, so large blocks can be formed again
+    void *big = MALLOC(24 * 1024 * 1024);
+    ck_assert_msg(big != NULL, "Heap did not coalesce after cross-thread frees");
+    FREE(big);
+}
+END_TEST
+
+#ifdef MM_SLABS
+/**
+ * @name   thread_free_objects
+ * @brief  Frees the 32-byte objects another thread allocated.
+ */
+static void *thread_free_objects(void *arg) {
+    void **objects = arg;
+    for (uint32_t n = 0; n < BLOCKS_PER_THREAD; n++) {
+        FREE(objects[n]);
+    }
+    return NULL;
+}
+
+/**
+ * @name   test_slabs_remote_free
+ * @brief  Objects freed by another thread wait on the owner's remote list until it allocates again.
+ */
+START_TEST(test_slabs_remote_free) {
+    static void *objects[BLOCKS_PER_THREAD];
+    SimpleStats before, after;
+    pthread_t consumer;
+
+    simple_mm_stats(&before);
+    for (uint32_t n = 0; n < BLOCKS_PER_THREAD; n++) {
+        objects[n] = MALLOC(32);
+        ck_assert(objects[n] != NULL);
+    }
+    pthread_create(&consumer, NULL, thread_free_objects, objects);
+    pthread_join(consumer, NULL);
+
+    simple_mm_stats(&after);
+    ck_assert(after.slab_objects == before.slab_objects + BLOCKS_PER_THREAD);
+
+    // The next allocation takes the whole list back and releases the emptied slabs
+    void *again = MALLOC(32);
+    ck_assert(again != NULL);
+    simple_mm_stats(&after);
+    ck_assert(after.slab_objects == before.slab_objects + 1);
+    ck_assert_msg(after.slabs <= before.slabs + 1, "%zu slabs not released", after.slabs - before.slabs);
+    FREE(again);
+}
+END_TEST
+#endif
+
+#endif
+
 /**
  * @name   simple_malloc_suite
  * @brief  Creates a test suite for the memory management system.
@@ -223,7 +1259,54 @@ Suite *simple_malloc_suite() {
     tcase_add_test(tc_core, test_simple_allocation);
     tcase_add_test(tc_core, test_simple_unique_addresses);
     tcase_add_test(tc_core, test_memory_exerciser);
+#ifdef MM_BUDDY
+    // Placement is fixed by the buddy system, and blocks grow into buddies rather than successors
+    tcase_add_test(tc_core, test_buddy);
+#else
     tcase_add_test(tc_core, test_non_first_fit_strategy);
+    tcase_add_test(tc_core, test_fit_policies);
+    tcase_add_test(tc_core, test_realloc);
+#endif
+#ifdef MM_TREE
+    tcase_add_test(tc_core, test_tree_best_fit);
+#endif
+    tcase_add_test(tc_core, test_memalign);
+    tcase_add_test(tc_core, test_calloc);
+    tcase_add_test(tc_core, test_stats);
+#ifndef MM_SHARED
+    // Shared heaps keep every block in the region
+    tcase_add_test(tc_core, test_mmap_threshold);
+#endif
+    tcase_add_test(tc_core, test_pool_allocation);
+    tcase_add_test(tc_core, test_arena);
+    tcase_add_test(tc_core, test_batch);
+#ifdef MM_HANDLES
+    tcase_add_test(tc_core, test_handles);
+#endif
+#ifdef MM_QUICKLISTS
+    tcase_add_test(tc_core, test_quicklists);
+#endif
+#ifdef MM_RELEASE
+    tcase_add_test(tc_core, test_release);
+#endif
+#ifdef MM_SHARED
+    tcase_add_test(tc_core, test_shared);
+#endif
+#ifdef MM_PROFILE
+    tcase_add_test(tc_core, test_profile);
+#endif
+#ifdef MM_SLABS
+    tcase_add_test(tc_core, test_slabs);
+#endif
+#ifdef MM_GROWABLE
+    tcase_add_test(tc_core, test_heap_growth);
+#endif
+#ifdef MM_THREADS
+    tcase_add_test(tc_core, test_threads_cross_free);
+#ifdef MM_SLABS
+    tcase_add_test(tc_core, test_slabs_remote_free);
+#endif
+#endif
 
     suite_add_tcase(s, tc_core);
     return s;
@@ -4,6 +4,8 @@
 // From A1/main.c:
 
 #include "mm.h"
+#include "mm_arena.h"
+#include "mm_pool.h"
 #include "io.h"
 #include <stdlib.h>
 
@@ -15,7 +17,10 @@ typedef struct Node {
 void add_to_collection(Node** head, int value);
 void remove_last(Node** head);
 void print_collection(Node* head);
-void free_collection(Node* head);
+void free_collection(Node** head);
+
+static SimpleArena* node_arena = NULL;  // Holds the slabs of node_pool, so the collection is freed at once
+static SimplePool* node_pool = NULL;    // All nodes of the collection come from this pool
 
 /**
  * @name  main
@@ -28,6 +33,13 @@ int main(void)
     Node* head = NULL;
     int command;
 
+    node_arena = simple_arena_create();
+    node_pool = (node_arena != NULL) ? simple_pool_create_in(node_arena, sizeof(Node)) : NULL;
+    if (node_pool == NULL) {
+        write_string("Memory allocation failed\n");
+        exit(1);
+    }
+
     while (1) {
         command = read_char();
         
@@ -56,13 +68,15 @@ int main(void)
     write_string("Collection: ");
     print_collection(head);
 
-    free_collection(head);
+    free_collection(&head);
+    simple_pool_destroy(node_pool);
+    simple_arena_destroy(node_arena);
 
     return 0;
 }
 
 void add_to_collection(Node** head, int value) {
-    Node* new_node = (Node*)simple_malloc(sizeof(Node));
+    Node* new_node = (Node*)simple_pool_alloc(node_pool);
     if (new_node == NULL) {
         write_string("Memory allocation failed\n");
         exit(1);
@@ -85,7 +99,7 @@ void remove_last(Node** head) {
     if (*head == NULL) return;
 
     if ((*head)->next == NULL) {
-        simple_free(*head);
+        simple_pool_free(node_pool, *head);
         *head = NULL;
         return;
     }
@@ -95,7 +109,7 @@ void remove_last(Node** head) {
         current = current->next;
     }
 
-    simple_free(current->next);
+    simple_pool_free(node_pool, current->next);
     current->next = NULL;
 }
 
@@ -114,11 +128,9 @@ void print_collection(Node* head) {
     write_char('\n');
 }
 
-void free_collection(Node* head) {
-    Node* current = head;
-    while (current != NULL) {
-        Node* next = current->next;
-        simple_free(current);
-        current = next;
-    }
+void free_collection(Node** head) {
+    // Every node lives in a slab of the arena, so they all go at once
+    simple_arena_reset(node_arena);
+    simple_pool_reset(node_pool);
+    *head = NULL;
 }
@@ -7,15 +7,126 @@
 * This file contains low level initialization of memory. You should
  * not need to edit this file as part of the assignment.
  *
+ * Built with MM_GROWABLE the memory is not a static array but a range of
+ * address space reserved with mmap, committed in chunks as the heap grows.
+ * Built with MM_SHARED it is a shared mapping several processes attach to.
  */
 
+#define _DEFAULT_SOURCE
+
 #include "mm.h"
 
-#define ALLOCATE_SIZE    32*1024*1024                 // 32 MB
+#ifdef MM_GROWABLE
+#include <sys/mman.h>
+#include <unistd.h>
+
+uintptr_t memory_start = 0;
+uintptr_t memory_end   = 0;                           // End of the committed part
+
+static uintptr_t reserve_end = 0;
+
+/**
+ * @name    memory_reserve
+ * @brief   Reserve the address space and commit the first initial bytes of it.
+ * @retval  0 on success, -1 if the reservation failed.
+ */
+int memory_reserve(size_t initial) {
+    void *base = mmap(NULL, MEMORY_MAX_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return -1;
+
+    memory_start = (uintptr_t)base;
+    memory_end   = memory_start;
+    reserve_end  = memory_start + MEMORY_MAX_SIZE;
+    return memory_grow(initial);
+}
+
+/**
+ * @name    memory_grow
+ * @brief   Commit at least size more bytes directly after memory_end, rounded up to whole pages.
+ * @retval  0 on success, -1 if the reservation is exhausted or the kernel refused.
+ */
+int memory_grow(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) & ~(page - 1);
+    if (size > reserve_end - memory_end) return -1;
+
+    if (mprotect((void *)memory_end, size, PROT_READ | PROT_WRITE) != 0) return -1;
+    // Release pairs with the acquire in mm.c's slab_page, which reads the end without the heap lock
+    __atomic_store_n(&memory_end, memory_end + size, __ATOMIC_RELEASE);
+    return 0;
+}
+#elif defined(MM_SHARED)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ATTACH_WAIT 1000                              // Milliseconds to wait for the creator to size the object
+
+uintptr_t memory_start = 0;
+uintptr_t memory_end   = 0;
+
+/**
+ * @name    memory_attach
+ * @brief   Map the shared memory object name, creating it with size bytes if it does not exist.
+ * @retval  1 if the region was created, 0 if an existing one was mapped, -1 on failure.
+ */
+int memory_attach(const char *name, size_t size) {
+    if (name == NULL) {
+        void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) return -1;
+        memory_start = (uintptr_t)base;
+        memory_end   = memory_start + size;
+        return 1;
+    }
+
+    int created = 1;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = 0;
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if (fd < 0) return -1;
+
+    if (created) {
+        if (ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return -1;
+        }
+    } else {
+        // The creator may not have sized it yet
+        struct stat st;
+        for (unsigned waited = 0; fstat(fd, &st) == 0 && st.st_size == 0 && waited < ATTACH_WAIT; waited++) {
+            usleep(1000);
+        }
+        size = (fstat(fd, &st) == 0) ? (size_t)st.st_size : 0;
+    }
+
+    void *base = (size == 0) ? MAP_FAILED : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+    memory_start = (uintptr_t)base;
+    memory_end   = memory_start + size;
+    return created;
+}
+
+/**
+ * @name    memory_detach
+ * @brief   Unmap the region mapped by memory_attach.
+ */
+void memory_detach(void) {
+    if (memory_start != 0) munmap((void *)memory_start, memory_end - memory_start);
+    memory_start = 0;
+    memory_end   = 0;
+}
+#else
 #define SKEW_SIZE        10
 
 static int8_t skew[SKEW_SIZE];                        // Misalignment
-static int8_t memory[ALLOCATE_SIZE];
+static int8_t memory[MEMORY_MAX_SIZE];
 
 const uintptr_t memory_start =  (uintptr_t) memory;
-const uintptr_t memory_end   =  (uintptr_t) memory + ALLOCATE_SIZE;
+const uintptr_t memory_end   =  (uintptr_t) memory + MEMORY_MAX_SIZE;
+#endif
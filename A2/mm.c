@@ -1,7 +1,36 @@
+#define _GNU_SOURCE  // mremap
+
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "mm.h"
 
+#if defined(MM_THREADS) || defined(MM_SHARED)
+#include <pthread.h>
+#endif
+#ifdef MM_SHARED
+#include <errno.h>
+#endif
+
+#if defined(MM_SEGLIST) && defined(MM_TREE)
+#error "MM_SEGLIST and MM_TREE are alternative free block indexes"
+#endif
+
+#if defined(MM_CLASSES) && !defined(MM_SEGLIST)
+#error "MM_CLASSES replaces the size classes of MM_SEGLIST"
+#endif
+
+#if defined(MM_SHARED) && (defined(MM_SEGLIST) || defined(MM_TREE) || defined(MM_SLABS) || defined(MM_HANDLES))
+#error "MM_SHARED keeps every process's view of the heap in the blocks, so free indexes, slabs and handles are not shared"
+#endif
+
+#if defined(MM_SHARED) && (defined(MM_THREADS) || defined(MM_QUICKLISTS) || defined(MM_GROWABLE))
+#error "MM_SHARED: caches would strand blocks when a process exits, and the region has a fixed size"
+#endif
+
 //Used GitHub CoPilot plugin for VSCode and http://perplexity.ai for a lot of bugfixing and refactoring
 
 /* Proposed data structure elements */
@@ -10,28 +39,357 @@ typedef struct header {
     uint64_t user_block[0];   // Empty array to ensure alignment of user block
 } BlockHeader;
 
+#ifdef MM_SHARED
+// Headers and footers hold offsets from the start of the region, so every process can map it at another address
+#define TO_WORD(p)   ((p) == NULL ? (uintptr_t)0 : (uintptr_t)(p) - memory_start)
+#define FROM_WORD(w) ((w) == 0 ? NULL : (BlockHeader *)(memory_start + (w)))
+#else
+#define TO_WORD(p)   ((uintptr_t)(p))
+#define FROM_WORD(w) ((BlockHeader *)(w))
+#endif
+
 // Macros to access fields in the header
 
-#define FREE_MASK 0x1 // Mask to extract the free bit
-#define GET_NEXT(p) ((BlockHeader *)((uintptr_t)(p->next) & ~FREE_MASK)) // Mask out the free bit
-#define SET_NEXT(p, n) p->next = (BlockHeader *)((uintptr_t)(n) | ((uintptr_t)(p->next) & FREE_MASK)) // Preserve the free bit
-#define GET_FREE(p) (uint8_t)((uintptr_t)(p->next) & FREE_MASK) // Extract the free bit
-#define SET_FREE(p, f) p->next = (BlockHeader *)((uintptr_t)GET_NEXT(p) | (f & FREE_MASK)) // Set the free bit
+#define FREE_MASK      0x1 // Mask to extract the free bit
+#define PREV_FREE_MASK 0x2 // Mask to extract the bit telling whether the preceding block is free
+#define MMAPPED_MASK   0x4 // Mask to extract the bit marking a block that is a mapping of its own
+#define FLAG_MASK      0x7 // All low bits available because blocks are 8-byte aligned
+#define GET_NEXT(p) FROM_WORD((uintptr_t)((p)->next) & ~FLAG_MASK) // Mask out the flag bits
+#define SET_NEXT(p, n) (p)->next = (BlockHeader *)(TO_WORD(n) | ((uintptr_t)((p)->next) & FLAG_MASK)) // Preserve the flag bits
+#define SET_LINK(p, n) (p)->next = (BlockHeader *)TO_WORD(n) // Set the next block and clear the flag bits
+#define GET_FREE(p) (uint8_t)((uintptr_t)((p)->next) & FREE_MASK) // Extract the free bit
+#define SET_FREE(p, f) (p)->next = (BlockHeader *)(((uintptr_t)((p)->next) & ~FREE_MASK) | ((f) & FREE_MASK)) // Set the free bit
+#define GET_PREV_FREE(p) (uint8_t)(((uintptr_t)((p)->next) & PREV_FREE_MASK) >> 1) // Extract the prev-free bit
+#define SET_PREV_FREE(p, f) (p)->next = (BlockHeader *)(((uintptr_t)((p)->next) & ~PREV_FREE_MASK) | (((f) << 1) & PREV_FREE_MASK)) // Set the prev-free bit
 #define SIZE(p) ((uintptr_t)GET_NEXT(p) - (uintptr_t)(p) - sizeof(BlockHeader)) // Calculate the size of the block
-#define MIN_SIZE (8)  // Minimum size of a block (excluding header)
+#define IS_MMAPPED(w) ((uintptr_t)(w) & MMAPPED_MASK) // Test a header word for a mapped block
+#define MMAP_LENGTH(w) ((uintptr_t)(w) & ~FLAG_MASK) // Length of the mapping, stored in place of the next pointer
+#define FOOTER(p) (((BlockHeader **)GET_NEXT(p)) - 1) // Last word of a free block, points back to its header
+#define SET_FOOTER(p) *FOOTER(p) = (BlockHeader *)TO_WORD(p) // Write the footer of a free block
+#define GET_PREV(p) FROM_WORD((uintptr_t)*(((BlockHeader **)(p)) - 1)) // Header of the preceding block, valid only if GET_PREV_FREE(p)
+
+#ifdef MM_SEGLIST
+/*
+ * Segregated explicit free lists: free blocks are threaded through size-class
+ * bins using the first two words of their (otherwise unused) user block.
+ */
+typedef struct free_links {
+    BlockHeader *next_free;
+    BlockHeader *prev_free;
+} FreeLinks;
+
+#define LINKS(p) ((FreeLinks *)(p)->user_block) // Free list links of a free block
+#define MIN_SIZE (sizeof(FreeLinks) + sizeof(BlockHeader *))  // Room for the links and the footer of a free block
+
+#define NUM_BINS        128
+#define BIN_WORDS       (NUM_BINS / 64)
+#ifdef MM_CLASSES
+// Size classes generated from a profile of the workload by size_classes
+#include "mm_classes.h"
+_Static_assert(sizeof(class_limits) / sizeof(class_limits[0]) == NUM_BINS, "mm_classes.h must define NUM_BINS classes");
+#else
+#define SMALL_BIN_SHIFT 9                          // Sizes below 512 bytes get one bin per 8 bytes
+#define SMALL_BINS      (1 << (SMALL_BIN_SHIFT - 3))  // Remaining bins hold one power of two each
+#endif
+
+static BlockHeader *bins[NUM_BINS];   // Head of the free list of each size class
+static uint64_t bin_map[BIN_WORDS];   // Bit set for each non-empty bin
+#elif defined(MM_TREE)
+/*
+ * Size-ordered treap of free blocks: every free block is a node keyed by its
+ * size and then its address, linked through the first two words of its user
+ * block. Priorities are a hash of the address, so they need no storage and
+ * keep the tree balanced in expectation.
+ */
+typedef struct tree_links {
+    BlockHeader *left;
+    BlockHeader *right;
+} TreeLinks;
+
+#define NODE(p) ((TreeLinks *)(p)->user_block) // Tree links of a free block
+#define MIN_SIZE (sizeof(TreeLinks) + sizeof(BlockHeader *))  // Room for the links and the footer of a free block
+
+static BlockHeader *tree_root = NULL;
+#else
+#define MIN_SIZE (8)  // Minimum size of a block (excluding header), room for the footer of a free block
+#endif
 
 static BlockHeader *first = NULL;
 static BlockHeader *current = NULL;
 
-extern const uintptr_t memory_start;
-extern const uintptr_t memory_end;
+// Everything from here to the end of the region is still zero as provided by
+// memory_setup.c, except the footer in the last word before the sentinel
+static uintptr_t clean_start = 0;
+static uintptr_t clean_end = UINTPTR_MAX;  // Slabs cut from the top of the heap are written below this
+#define FREE_HEAD_SIZE (sizeof(BlockHeader) + 2 * sizeof(BlockHeader *)) // Header and links written at the start of a free block
+
+#ifndef MM_DEFAULT_FIT
+#define MM_DEFAULT_FIT MM_FIT_NEXT  // Placement policy until simple_set_fit is called
+#endif
+#define GOOD_FIT_SEARCH 32          // Blocks good-fit examines after its first candidate
+
+static SimpleFit fit_policy = MM_DEFAULT_FIT;
+
+#ifndef MM_MMAP_THRESHOLD
+#define MM_MMAP_THRESHOLD 0         // Requests of at least this size get their own mapping, 0 disables
+#endif
+
+static size_t mmap_threshold = MM_MMAP_THRESHOLD;
+
+// Mapped blocks, updated atomically since they bypass the heap lock
+static uint64_t mmapped_blocks = 0;
+static uint64_t mmapped_bytes = 0;
+
+// Event counters reported by simple_mm_stats, updated under the heap lock
+static uint64_t search_histogram[MM_SEARCH_BUCKETS];
+static uint64_t split_count = 0;
+static uint64_t coalesce_count = 0;
+
+#ifdef MM_SHARED
+/*
+ * The region starts with the state every process has to agree on. Whoever
+ * holds the lock copies the rover and the clean mark into the globals below
+ * and back, so the rest of this file works on them as in a private heap.
+ */
+#define SHARED_MAGIC 0x73696d706c656d6dull  // Written last when a new region has been laid out
+#define SHARED_WAIT  1000                   // Milliseconds to wait for the process laying out a region
+
+typedef struct shared_heap {
+    uint64_t magic;
+    pthread_mutex_t lock;     // Process-shared and robust, protects every block
+    uint64_t first;           // Offsets from the start of the region, as in the headers
+    uint64_t sentinel;
+    uint64_t current;
+    uint64_t clean_start;
+    uint64_t root;            // Block published with simple_shared_set_root, 0 for none
+} SharedHeap;
+
+static SharedHeap *shared = NULL;  // Start of the region in this process, NULL while detached
+static pthread_mutex_t shared_attach_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void shared_lock(void);
+static void shared_unlock(void);
+#define HEAP_LOCK()   shared_lock()
+#define HEAP_UNLOCK() shared_unlock()
+#elif defined(MM_THREADS)
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;  // Protects every block and the free lists
+#define HEAP_LOCK()   pthread_mutex_lock(&heap_lock)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&heap_lock)
+#else
+#define HEAP_LOCK()   ((void)0)
+#define HEAP_UNLOCK() ((void)0)
+#endif
+
+#ifdef MM_GROWABLE
+#define MEMORY_INITIAL (256 * 1024)    // Bytes committed when the heap is created
+#define MEMORY_GROW    (1024 * 1024)   // Minimum bytes committed when the heap runs out
+
+#endif
+
+static BlockHeader *sentinel = NULL;   // The end block, moved up whenever the heap grows
+
+static void heap_free(void *ptr);
+
+#ifdef MM_SEGLIST
+/**
+ * @name    bin_index
+ * @brief   Size class of a free block with `size` bytes of user block.
+ */
+static unsigned bin_index(size_t size) {
+#ifdef MM_CLASSES
+    if (size <= CLASS_EXACT) return class_small[size >> 3];
+
+    // Last class whose smallest size fits
+    unsigned low = class_small[CLASS_EXACT >> 3], high = NUM_BINS - 1;
+    while (low < high) {
+        unsigned mid = (low + high + 1) / 2;
+        if (class_limits[mid] <= size) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+#else
+    if (size < (1 << SMALL_BIN_SHIFT)) return size >> 3;
+    return SMALL_BINS + (63 - __builtin_clzll(size)) - SMALL_BIN_SHIFT;
+#endif
+}
+
+/**
+ * @name    bin_insert
+ * @brief   Push a free block on the list of its size class.
+ */
+static void bin_insert(BlockHeader *block) {
+    unsigned bin = bin_index(SIZE(block));
+    LINKS(block)->next_free = bins[bin];
+    LINKS(block)->prev_free = NULL;
+    if (bins[bin] != NULL) LINKS(bins[bin])->prev_free = block;
+    bins[bin] = block;
+    bin_map[bin / 64] |= 1ull << (bin % 64);
+}
+
+/**
+ * @name    bin_remove
+ * @brief   Unlink a free block from the list of its size class.
+ *
+ * Must be called before the size of the block changes.
+ */
+static void bin_remove(BlockHeader *block) {
+    unsigned bin = bin_index(SIZE(block));
+    BlockHeader *next = LINKS(block)->next_free;
+    BlockHeader *prev = LINKS(block)->prev_free;
+    if (next != NULL) LINKS(next)->prev_free = prev;
+    if (prev != NULL) {
+        LINKS(prev)->next_free = next;
+    } else {
+        bins[bin] = next;
+        if (next == NULL) bin_map[bin / 64] &= ~(1ull << (bin % 64));
+    }
+}
+
+/**
+ * @name    next_nonempty_bin
+ * @brief   Lowest non-empty bin at or above `bin`, or NUM_BINS if there is none.
+ */
+static unsigned next_nonempty_bin(unsigned bin) {
+    for (unsigned word = bin / 64; word < BIN_WORDS; word++) {
+        uint64_t bits = bin_map[word];
+        if (word == bin / 64) bits &= ~0ull << (bin % 64);
+        if (bits != 0) return word * 64 + __builtin_ctzll(bits);
+    }
+    return NUM_BINS;
+}
+#elif defined(MM_TREE)
+/**
+ * @name    tree_priority
+ * @brief   Heap priority of a node, a multiplicative hash of its address.
+ */
+static uint64_t tree_priority(BlockHeader *block) {
+    return ((uintptr_t)block >> 3) * 0x9e3779b97f4a7c15ull;
+}
+
+/**
+ * @name    tree_less
+ * @brief   Whether `a` orders before `b`: smaller blocks first, ties broken by address.
+ */
+static int tree_less(BlockHeader *a, BlockHeader *b) {
+    size_t size_a = SIZE(a), size_b = SIZE(b);
+    return size_a < size_b || (size_a == size_b && (uintptr_t)a < (uintptr_t)b);
+}
+
+/**
+ * @name    bin_insert
+ * @brief   Insert a free block into the tree.
+ *
+ * The block goes where its priority belongs, and the subtree it displaces is
+ * split around its key into its two children, so no rotations are needed.
+ */
+static void bin_insert(BlockHeader *block) {
+    uint64_t priority = tree_priority(block);
+    BlockHeader **link = &tree_root;
+    while (*link != NULL && tree_priority(*link) > priority) {
+        link = tree_less(block, *link) ? &NODE(*link)->left : &NODE(*link)->right;
+    }
+
+    BlockHeader *rest = *link;
+    BlockHeader **left = &NODE(block)->left, **right = &NODE(block)->right;
+    while (rest != NULL) {
+        if (tree_less(rest, block)) {
+            *left = rest;
+            left = &NODE(rest)->right;
+            rest = *left;
+        } else {
+            *right = rest;
+            right = &NODE(rest)->left;
+            rest = *right;
+        }
+    }
+    *left = NULL;
+    *right = NULL;
+    *link = block;
+}
+
+/**
+ * @name    bin_remove
+ * @brief   Remove a free block from the tree, replacing it by the merge of its children.
+ *
+ * Must be called before the size of the block changes.
+ */
+static void bin_remove(BlockHeader *block) {
+    BlockHeader **link = &tree_root;
+    while (*link != block) {
+        link = tree_less(block, *link) ? &NODE(*link)->left : &NODE(*link)->right;
+    }
+
+    // Every key on the left is smaller, so the merge only follows priorities
+    BlockHeader *left = NODE(block)->left, *right = NODE(block)->right;
+    while (left != NULL && right != NULL) {
+        if (tree_priority(left) > tree_priority(right)) {
+            *link = left;
+            link = &NODE(left)->right;
+            left = *link;
+        } else {
+            *link = right;
+            link = &NODE(right)->left;
+            right = *link;
+        }
+    }
+    *link = (left != NULL) ? left : right;
+}
+#else
+#define bin_insert(block) ((void)0)
+#define bin_remove(block) ((void)0)
+#endif
+
+/**
+ * @name    mark_free
+ * @brief   Mark a block as free and write its boundary tag.
+ *
+ * The footer lets the following block find this one in O(1) when it is
+ * freed, and the prev-free bit of the following block tells it to look.
+ */
+static void mark_free(BlockHeader *block) {
+    SET_FREE(block, 1);
+    SET_FOOTER(block);
+    SET_PREV_FREE(GET_NEXT(block), 1);
+}
+
+/**
+ * @name    mark_allocated
+ * @brief   Mark a block as allocated. Its footer becomes part of the user block.
+ */
+static void mark_allocated(BlockHeader *block) {
+    SET_FREE(block, 0);
+    SET_PREV_FREE(GET_NEXT(block), 0);
+}
+
+/**
+ * @name    next_in_heap
+ * @brief   Block following `block`, wrapping around from the sentinel to `first`.
+ */
+static BlockHeader *next_in_heap(BlockHeader *block) {
+    BlockHeader *next = GET_NEXT(block);
+    return next != NULL ? next : first;
+}
 
 /**
  * @name    simple_init
  * @brief   Initialize the block structure within the available memory
  */
 void simple_init() {
+#ifdef MM_GROWABLE
+    if (memory_start == 0 && memory_reserve(MEMORY_INITIAL) != 0) return;
+#endif
+#ifdef MM_SHARED
+    if (memory_start == 0) {
+        simple_shared_attach(NULL, MEMORY_MAX_SIZE);  // Lays out the blocks through here
+        return;
+    }
+    uintptr_t aligned_memory_start = (memory_start + sizeof(SharedHeap) + 7) & ~7;  // After the shared state
+#else
     uintptr_t aligned_memory_start = (memory_start + 7) & ~7;  // Align to 8-byte boundary
+#endif
     uintptr_t aligned_memory_end = memory_end & ~7;             // Align to 8-byte boundary
 
     if (first == NULL) {
@@ -39,83 +397,588 @@ void simple_init() {
         if (aligned_memory_start + 2 * sizeof(BlockHeader) + MIN_SIZE <= aligned_memory_end) {
             // Create the first free block
             first = (BlockHeader *)aligned_memory_start;
-            first->next = (BlockHeader *)(aligned_memory_end - sizeof(BlockHeader));  // Set the next to the end block
-            SET_FREE(first, 1);  // Mark as free
+            SET_LINK(first, (BlockHeader *)(aligned_memory_end - sizeof(BlockHeader)));  // Set the next to the end block
 
             // Create the last block as a sentinel
             BlockHeader *last = GET_NEXT(first);
-            last->next = NULL;  // End of the list
+            SET_LINK(last, NULL);  // End of the list
             SET_FREE(last, 0);  // Mark as allocated (end marker)
+            sentinel = last;
+
+            mark_free(first);  // Mark as free, sets the prev-free bit of the sentinel
+            bin_insert(first);
+            clean_start = (uintptr_t)first + FREE_HEAD_SIZE;
 
             // Set the current pointer for next-fit strategy
             current = first;
+
+#ifdef MM_HUGEPAGES
+            // Ask for transparent huge pages over the whole region, committed or not
+#ifdef MM_GROWABLE
+            uintptr_t region_end = memory_start + MEMORY_MAX_SIZE;
+#else
+            uintptr_t region_end = memory_end;
+#endif
+            uintptr_t huge_start = (memory_start + 2 * 1024 * 1024 - 1) & ~(uintptr_t)(2 * 1024 * 1024 - 1);
+            uintptr_t huge_end = region_end & ~(uintptr_t)(2 * 1024 * 1024 - 1);
+            if (huge_start < huge_end) madvise((void *)huge_start, huge_end - huge_start, MADV_HUGEPAGE);
+#endif
         }
     }
 }
 
+#ifdef MM_SHARED
 /**
- * @name    simple_malloc
- * @brief   Allocate at least `size` contiguous bytes of memory and return a pointer to the first byte.
- * @param   size_t size Number of bytes to allocate.
+ * @name    shared_create
+ * @brief   Set up the lock and the blocks of a region this process has just created.
+ * @retval  0 on success, -1 if the lock could not be created or the region is too small.
+ */
+static int shared_create(void) {
+    SharedHeap *heap = (SharedHeap *)memory_start;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);  // Survive a process that dies holding it
+    int failed = pthread_mutex_init(&heap->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (failed) return -1;
+
+    simple_init();
+    if (first == NULL) return -1;
+    heap->first = TO_WORD(first);
+    heap->sentinel = TO_WORD(sentinel);
+    heap->current = TO_WORD(current);
+    heap->clean_start = clean_start - memory_start;
+    heap->root = 0;
+    __atomic_store_n(&heap->magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @name    shared_open
+ * @brief   Pick up a region another process created, waiting until it is laid out.
+ * @retval  0 on success, -1 if it was not laid out within SHARED_WAIT milliseconds.
+ */
+static int shared_open(void) {
+    SharedHeap *heap = (SharedHeap *)memory_start;
+    for (unsigned waited = 0; __atomic_load_n(&heap->magic, __ATOMIC_ACQUIRE) != SHARED_MAGIC; waited++) {
+        if (waited == SHARED_WAIT) return -1;
+        usleep(1000);
+    }
+    first = FROM_WORD(heap->first);
+    sentinel = FROM_WORD(heap->sentinel);
+    current = first;
+    return 0;
+}
+
+/**
+ * @name    simple_shared_attach
+ * @brief   Map the shared memory object `name` as the heap, laying it out if this process creates it.
+ * @retval  0 on success, -1 if a heap is attached already or the region could not be mapped.
+ */
+int simple_shared_attach(const char *name, size_t size) {
+    int result = -1;
+    pthread_mutex_lock(&shared_attach_lock);
+    if (__atomic_load_n(&shared, __ATOMIC_ACQUIRE) == NULL) {
+        int created = memory_attach(name, size);
+        if (created >= 0) {
+            result = created ? shared_create() : shared_open();
+            if (result == 0) {
+                __atomic_store_n(&shared, (SharedHeap *)memory_start, __ATOMIC_RELEASE);
+            } else {
+                first = current = sentinel = NULL;
+                memory_detach();
+            }
+        }
+    }
+    pthread_mutex_unlock(&shared_attach_lock);
+    return result;
+}
+
+/**
+ * @name    simple_shared_detach
+ * @brief   Unmap the heap of this process. Its blocks stay allocated for the other processes.
+ */
+void simple_shared_detach(void) {
+    pthread_mutex_lock(&shared_attach_lock);
+    if (shared != NULL) {
+        __atomic_store_n(&shared, NULL, __ATOMIC_RELEASE);
+        first = current = sentinel = NULL;
+        clean_start = 0;
+        memory_detach();
+    }
+    pthread_mutex_unlock(&shared_attach_lock);
+}
+
+/**
+ * @name    shared_lock
+ * @brief   Take the lock of the region, attaching an unnamed one on first use, and load the shared state.
+ */
+static void shared_lock(void) {
+    if (__atomic_load_n(&shared, __ATOMIC_ACQUIRE) == NULL && simple_shared_attach(NULL, MEMORY_MAX_SIZE) != 0) return;
+
+    if (pthread_mutex_lock(&shared->lock) == EOWNERDEAD) {
+        printf("Warning: A process died while holding the heap lock, the heap may be inconsistent.\n");
+        pthread_mutex_consistent(&shared->lock);
+    }
+    current = FROM_WORD(shared->current);
+    clean_start = memory_start + shared->clean_start;
+}
+
+/**
+ * @name    shared_unlock
+ * @brief   Store the shared state for the next process and release the lock.
+ */
+static void shared_unlock(void) {
+    if (shared == NULL) return;
+    shared->current = TO_WORD(current);
+    shared->clean_start = clean_start - memory_start;
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/**
+ * @name    simple_shared_offset
+ * @brief   Position of `ptr` in the region, the same in every process; 0 for NULL.
+ */
+uint64_t simple_shared_offset(const void *ptr) {
+    return (ptr == NULL) ? 0 : (uintptr_t)ptr - memory_start;
+}
+
+/**
+ * @name    simple_shared_pointer
+ * @brief   Address in this process of the position `offset` returned by simple_shared_offset.
+ */
+void *simple_shared_pointer(uint64_t offset) {
+    return (offset == 0) ? NULL : (void *)(memory_start + offset);
+}
+
+/**
+ * @name    simple_shared_set_root
+ * @brief   Publish `ptr` for the other processes to find with simple_shared_root.
+ */
+void simple_shared_set_root(const void *ptr) {
+    HEAP_LOCK();
+    if (shared != NULL) shared->root = simple_shared_offset(ptr);
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_shared_root
+ * @brief   The block last published with simple_shared_set_root by any process, or NULL.
+ */
+void *simple_shared_root(void) {
+    HEAP_LOCK();
+    uint64_t root = (shared != NULL) ? shared->root : 0;
+    HEAP_UNLOCK();
+    return simple_shared_pointer(root);
+}
+#endif
+
+/**
+ * @name    align_size
+ * @brief   Round a request up to a multiple of 8 bytes and at least MIN_SIZE.
+ */
+static size_t align_size(size_t size) {
+    size_t aligned_size = (size + 7) & ~7;
+    return aligned_size < MIN_SIZE ? MIN_SIZE : aligned_size;
+}
+
+/**
+ * @name    record_search
+ * @brief   Count a search that examined `visited` blocks in its power-of-two histogram bucket.
+ */
+static void record_search(uint64_t visited) {
+    unsigned bucket = (visited == 0) ? 0 : 64 - __builtin_clzll(visited);
+    if (bucket >= MM_SEARCH_BUCKETS) bucket = MM_SEARCH_BUCKETS - 1;
+    search_histogram[bucket]++;
+}
+
+#ifdef MM_RELEASE
+/*
+ * Whole pages inside large free blocks are given back to the kernel, so the
+ * resident size follows the live data instead of the peak. A free whose block
+ * coalesces into one of at least RELEASE_MIN bytes releases the whole block
+ * when that doubled the largest free block it was merged with, and otherwise
+ * only the pages the freed block touched, so small frees next to a released
+ * block are caught up with at the next doubling. Ranges below
+ * release_threshold are skipped, and the threshold adapts: an allocation
+ * landing on the pages released last means the heap is cycling through that
+ * memory and faulting it back in every round, so the threshold rises above
+ * that range, like the dynamic mmap threshold of glibc; every RELEASE_DECAY
+ * frees it held back, it halves again. Caller holds the heap lock for all of
+ * these.
+ */
+#if !defined(MM_RELEASE_ADVICE) && defined(MM_SHARED)
+#define MM_RELEASE_ADVICE  MADV_REMOVE          // Shared memory keeps its pages through MADV_DONTNEED
+#elif !defined(MM_RELEASE_ADVICE)
+#define MM_RELEASE_ADVICE  MADV_DONTNEED        // MADV_FREE is cheaper but the pages only leave under memory pressure
+#endif
+#define RELEASE_MIN        (256 * 1024)         // Free blocks below this keep their pages
+#define RELEASE_RANGE      (64 * 1024)          // Initial and smallest threshold
+#define RELEASE_MAX        (1024 * 1024 * 1024) // Largest threshold
+#define RELEASE_DECAY      16                   // Frees held back by the threshold before it halves
+#ifdef MM_HUGEPAGES
+#define RELEASE_UNIT       (2 * 1024 * 1024)    // Release whole huge pages only, so the rest are not split
+#endif
+
+static size_t release_threshold = RELEASE_RANGE;  // Smallest range worth a system call
+static unsigned release_held = 0;         // Frees held back since the threshold last changed
+static uintptr_t release_last_start = 0;  // Range released last, [start, end)
+static uintptr_t release_last_end = 0;
+static uint64_t released_bytes = 0;
+
+/**
+ * @name    release_unit
+ * @brief   Granularity of a release, a page or a huge page.
+ */
+static size_t release_unit(void) {
+#ifdef MM_HUGEPAGES
+    return RELEASE_UNIT;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/**
+ * @name    release_pages
+ * @brief   Release the whole units of the free block `block` that lie within [start, end).
+ *
+ * The header, links and footer stay resident, and so does everything above
+ * clean_start, which was never written and so holds no pages yet.
+ */
+static void release_pages(BlockHeader *block, uintptr_t start, uintptr_t end) {
+    uintptr_t unit = release_unit();
+    if (start < (uintptr_t)block + FREE_HEAD_SIZE) start = (uintptr_t)block + FREE_HEAD_SIZE;
+    if (end > (uintptr_t)FOOTER(block)) end = (uintptr_t)FOOTER(block);
+    if (end > clean_start) end = clean_start;
+    start = (start + unit - 1) & ~(unit - 1);
+    end &= ~(unit - 1);
+    if (end <= start) return;
+
+    if (end - start < release_threshold) {
+        if (++release_held >= RELEASE_DECAY && release_threshold / 2 >= RELEASE_RANGE) {
+            release_threshold /= 2;
+            release_held = 0;
+        }
+        return;
+    }
+    if (madvise((void *)start, end - start, MM_RELEASE_ADVICE) != 0) return;
+    release_last_start = start;
+    release_last_end = end;
+    released_bytes += end - start;
+}
+
+/**
+ * @name    release_free
+ * @brief   Release pages after [start, end) was freed and coalesced into `block`.
+ * @param   size_t neighbour Size of the largest free block it was merged with, 0 for none.
+ */
+static void release_free(BlockHeader *block, uintptr_t start, uintptr_t end, size_t neighbour) {
+    if (SIZE(block) < RELEASE_MIN) return;
+    if (neighbour < RELEASE_MIN || SIZE(block) / 2 >= neighbour) {
+        release_pages(block, (uintptr_t)block, (uintptr_t)GET_NEXT(block));
+    } else {
+        // The neighbour was released already, widen the range to the pages shared with it
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        release_pages(block, start & ~(page - 1), (end + page - 1) & ~(page - 1));
+    }
+}
+
+/**
+ * @name    release_reuse
+ * @brief   Raise the threshold if the allocated block `block` lands on the pages released last.
+ */
+static void release_reuse(BlockHeader *block) {
+    if ((uintptr_t)GET_NEXT(block) <= release_last_start || (uintptr_t)block >= release_last_end) return;
+
+    // Above the range just released, so a repeat of the same cycle keeps its pages
+    size_t raised = release_last_end - release_last_start + release_unit();
+    if (raised < 2 * release_threshold) raised = 2 * release_threshold;
+    release_threshold = (raised < RELEASE_MAX) ? raised : RELEASE_MAX;
+    release_last_start = release_last_end = 0;  // Count each release once
+    release_held = 0;
+}
+#endif
+
+/**
+ * @name    mark_dirty
+ * @brief   Record that an allocated block, and the free block header after it, may have been written.
+ */
+static void mark_dirty(BlockHeader *block) {
+    uintptr_t end = (uintptr_t)GET_NEXT(block) + FREE_HEAD_SIZE;
+    if (end > clean_start) clean_start = end;
+#ifdef MM_RELEASE
+    release_reuse(block);
+#endif
+}
+
+#ifndef MM_TREE
+/**
+ * @name    better_fit
+ * @brief   Apply the placement policy to a candidate block that is large enough.
+ * @param   BlockHeader **best Best candidate so far, updated in place.
+ * @param   uint64_t *budget Blocks good-fit may still examine, armed by its first candidate.
+ * @retval  1 if the search can stop with *best, 0 to keep looking.
+ */
+static int better_fit(BlockHeader **best, BlockHeader *block, size_t size, uint64_t *budget) {
+    if (fit_policy == MM_FIT_FIRST || fit_policy == MM_FIT_NEXT) {
+        *best = block;
+        return 1;
+    }
+
+    if (*best == NULL || SIZE(block) < SIZE(*best)) *best = block;
+    if (fit_policy == MM_FIT_GOOD && *budget == UINT64_MAX) *budget = GOOD_FIT_SEARCH;
+    return SIZE(*best) == size;  // Nothing can fit better than an exact match
+}
+#endif
+
+#ifdef MM_SEGLIST
+/**
+ * @name    scan_bin
+ * @brief   Search one free list for a block of at least `size` bytes using the placement policy.
+ */
+static BlockHeader *scan_bin(BlockHeader *block, size_t size, uint64_t *visited) {
+    BlockHeader *best = NULL;
+    uint64_t budget = UINT64_MAX;
+    for (; block != NULL && budget > 0; block = LINKS(block)->next_free, budget--) {
+        (*visited)++;
+        if (SIZE(block) >= size && better_fit(&best, block, size, &budget)) break;
+    }
+    return best;
+}
+#endif
+
+/**
+ * @name    find_fit
+ * @brief   Find a free block with at least `size` bytes of user block.
+ * @param   uint64_t *visited Incremented for every block examined.
+ * @retval  The block, still marked free, or NULL if there is none.
+ */
+static BlockHeader *find_fit(size_t size, uint64_t *visited) {
+#ifdef MM_SEGLIST
+    // The bin of the requested size may also hold smaller blocks, so check each one
+    unsigned bin = bin_index(size);
+    BlockHeader *block = scan_bin(bins[bin], size, visited);
+    if (block != NULL) return block;
+
+    // Every block in a higher bin is large enough, so first- and next-fit take the head
+    bin = next_nonempty_bin(bin + 1);
+    if (bin == NUM_BINS) return NULL;
+    if (fit_policy == MM_FIT_FIRST || fit_policy == MM_FIT_NEXT) {
+        (*visited)++;
+        return bins[bin];
+    }
+    return scan_bin(bins[bin], size, visited);
+#elif defined(MM_TREE)
+    // The leftmost node that is large enough is the best fit, whatever the policy
+    BlockHeader *best = NULL;
+    for (BlockHeader *node = tree_root; node != NULL;) {
+        (*visited)++;
+        if (SIZE(node) >= size) {
+            best = node;
+            node = NODE(node)->left;
+        } else {
+            node = NODE(node)->right;
+        }
+    }
+    return best;
+#else
+    // First- and best-fit search from the start of the heap, next- and good-fit from the roving pointer
+    BlockHeader *search_start = (fit_policy == MM_FIT_FIRST || fit_policy == MM_FIT_BEST) ? first : current;
+    BlockHeader *block = search_start, *best = NULL;
+    uint64_t budget = UINT64_MAX;
+    do {
+        (*visited)++;
+        if (GET_FREE(block) && SIZE(block) >= size && better_fit(&best, block, size, &budget)) break;
+
+        // Move to the next block
+        block = next_in_heap(block);
+    } while (block != search_start && --budget > 0);  // Stop if we come back to the starting block
+
+    return best;
+#endif
+}
+
+/**
+ * @name    place
+ * @brief   Allocate `size` bytes at the start of the free block `block`.
+ *
+ * The tail is split off as a new free block when it is large enough to hold one.
+ */
+static void place(BlockHeader *block, size_t size) {
+    size_t block_size = SIZE(block);
+    bin_remove(block);
+
+    // If the remainder of the block is too small, use the entire block
+    if (block_size - size < sizeof(BlockHeader) + MIN_SIZE) {
+        mark_allocated(block);  // Mark the entire block as allocated
+    } else {
+        // Split the block: create a new block with the remaining space
+        BlockHeader *new_block = (BlockHeader *)((uintptr_t)block + sizeof(BlockHeader) + size);
+        SET_LINK(new_block, GET_NEXT(block));  // Link new block to the next block
+        SET_PREV_FREE(new_block, 0);           // Preceded by the block we are allocating
+        mark_free(new_block);                  // Mark new block as free
+        bin_insert(new_block);
+
+        // Update the block's next pointer and mark it as allocated
+        SET_NEXT(block, new_block);
+        SET_FREE(block, 0);
+        split_count++;
+    }
+    mark_dirty(block);
+}
+
+#ifdef MM_GROWABLE
+/**
+ * @name    heap_extend
+ * @brief   Commit more memory and append it to the heap as a free block of at least `size` bytes.
+ * @retval  The new free block, merged with a free block before the old sentinel, or NULL.
+ *
+ * The old sentinel becomes the header of the new block and a new sentinel is
+ * written at the end of the committed memory.
+ */
+static BlockHeader *heap_extend(size_t size) {
+    uintptr_t old_end = memory_end;
+    size_t grow = size + 2 * sizeof(BlockHeader);
+    if (grow < MEMORY_GROW) grow = MEMORY_GROW;
+    if (memory_grow(grow) != 0) return NULL;
+
+    BlockHeader *new_last = (BlockHeader *)((memory_end & ~7) - sizeof(BlockHeader));
+    SET_LINK(new_last, NULL);
+
+    // Turn the old sentinel into an allocated block and free it to coalesce backwards
+    BlockHeader *old_last = sentinel;
+    SET_NEXT(old_last, new_last);
+    sentinel = new_last;
+    heap_free(old_last->user_block);
+
+    // The old footer and sentinel are now inside the free block
+    if (clean_start < old_end + FREE_HEAD_SIZE) clean_start = old_end + FREE_HEAD_SIZE;
+    return current;  // heap_free left the merged block here
+}
+#endif
+
+#ifdef MM_QUICKLISTS
+/*
+ * Deferred coalescing: freed blocks up to QUICK_MAX_SIZE go onto a list per
+ * exact size and stay marked allocated, so neither neighbour merges with them
+ * and the next request of that size takes one back in O(1). They are
+ * coalesced all at once when a request finds no free block, when more than
+ * QUICK_LIMIT bytes are waiting, or before a large request, which would
+ * otherwise be placed around them. Caller holds the heap lock for all of these.
+ */
+#define QUICK_MAX_SIZE  256                        // Largest user block kept on a quick list, as for a thread cache
+#define QUICK_CLASSES   (QUICK_MAX_SIZE / 8 + 1)   // One list per multiple of 8 bytes
+#define QUICK_LIMIT     (256 * 1024)               // Bytes of user blocks waiting before everything is coalesced
+#define QUICK_LARGE     1024                       // Requests from this size on coalesce the waiting blocks first
+
+#define QUICK_NEXT(p) (*(BlockHeader **)(p)->user_block) // Link to the next block on a quick list
+
+static BlockHeader *quick_head[QUICK_CLASSES];
+static size_t quick_bytes = 0;       // User bytes of every block on the quick lists
+static size_t quick_blocks = 0;
+
+/**
+ * @name    quick_flush
+ * @brief   Free every block on the quick lists into the heap, coalescing them.
+ * @retval  1 if any block was freed, 0 if the lists were empty.
+ */
+static int quick_flush(void) {
+    if (quick_blocks == 0) return 0;
+    for (unsigned cls = 0; cls < QUICK_CLASSES; cls++) {
+        while (quick_head[cls] != NULL) {
+            BlockHeader *block = quick_head[cls];
+            quick_head[cls] = QUICK_NEXT(block);
+            heap_free(block->user_block);
+        }
+    }
+    quick_bytes = 0;
+    quick_blocks = 0;
+    return 1;
+}
+
+/**
+ * @name    quick_push
+ * @brief   Defer the free of an allocated block. Returns 0 if it is too large to be deferred.
+ */
+static int quick_push(BlockHeader *block) {
+    size_t size = SIZE(block);
+    if (size > QUICK_MAX_SIZE) return 0;
+
+    unsigned cls = size >> 3;
+    if (quick_head[cls] == block) {
+        printf("Warning: Attempting to free an already free block at address %p.\n", (void *)block->user_block);
+        return 1;
+    }
+    if (quick_bytes + size > QUICK_LIMIT) quick_flush();
+    QUICK_NEXT(block) = quick_head[cls];
+    quick_head[cls] = block;
+    quick_bytes += size;
+    quick_blocks++;
+    return 1;
+}
+
+/**
+ * @name    quick_pop
+ * @brief   Take a deferred block of exactly `aligned_size` bytes, or NULL if there is none.
+ */
+static void *quick_pop(size_t aligned_size) {
+    if (aligned_size > QUICK_MAX_SIZE) return NULL;
+
+    unsigned cls = aligned_size >> 3;
+    BlockHeader *block = quick_head[cls];
+    if (block == NULL) return NULL;
+    quick_head[cls] = QUICK_NEXT(block);
+    quick_bytes -= aligned_size;
+    quick_blocks--;
+    return (void *)(block->user_block);
+}
+#endif
+
+/**
+ * @name    heap_malloc
+ * @brief   Allocate `aligned_size` bytes from the shared heap. Caller holds the heap lock.
+ * @param   size_t aligned_size Number of bytes to allocate, a multiple of 8 and at least MIN_SIZE.
  * @retval  Pointer to the start of the allocated memory or NULL if not possible.
  */
-void *simple_malloc(size_t size) {
+static void *heap_malloc(size_t aligned_size) {
     if (first == NULL) {
         simple_init();  // Initialize memory if not done already
         if (first == NULL) return NULL;
     }
 
-    // Align the requested size to a multiple of 8 bytes
-    size_t aligned_size = (size + 7) & ~7;
+#ifdef MM_QUICKLISTS
+    if (aligned_size >= QUICK_LARGE) quick_flush();
+#endif
 
-    // Start searching for a suitable free block using the next-fit strategy
-    BlockHeader *search_start = current;
-    do {
-        if (GET_FREE(current)) {
-            size_t current_block_size = SIZE(current);
-
-            // Check if the current free block is large enough for the requested size
-            if (current_block_size >= aligned_size) {
-                // If the remainder of the block is too small, use the entire block
-                if (current_block_size - aligned_size < sizeof(BlockHeader) + MIN_SIZE) {
-                    SET_FREE(current, 0);  // Mark the entire block as allocated
-                } else {
-                    // Split the block: create a new block with the remaining space
-                    BlockHeader *new_block = (BlockHeader *)((uintptr_t)current + sizeof(BlockHeader) + aligned_size);
-                    new_block->next = GET_NEXT(current);  // Link new block to the next block
-                    SET_FREE(new_block, 1);               // Mark new block as free
-
-                    // Update the current block's next pointer and mark it as allocated
-                    SET_NEXT(current, new_block);
-                    SET_FREE(current, 0);
-                }
-
-                // Save the pointer to the user memory region
-                void *user_pointer = (void *)(current->user_block);
-
-                // Move the `current` pointer to the next block for the next-fit strategy
-                current = GET_NEXT(current);
-
-                return user_pointer;  // Return the address of the user block (after the header)
-            }
-        }
+    uint64_t visited = 0;
+    BlockHeader *block = find_fit(aligned_size, &visited);
+#ifdef MM_QUICKLISTS
+    if (block == NULL && quick_flush()) block = find_fit(aligned_size, &visited);
+#endif
+    record_search(visited);
+#ifdef MM_GROWABLE
+    if (block == NULL) block = heap_extend(aligned_size);
+#endif
+    if (block == NULL) return NULL;  // No suitable block found
 
-        // Move to the next block
-        current = GET_NEXT(current);
-    } while (current != search_start);  // Stop if we come back to the starting block
+    place(block, aligned_size);
+
+    // Move the `current` pointer to the next block for the next-fit strategy
+    current = next_in_heap(block);
 
-    // No suitable block found
-    return NULL;
+    return (void *)(block->user_block);  // Return the address of the user block (after the header)
 }
 
 /**
- * @name    simple_free
- * @brief   Frees previously allocated memory and makes it available for subsequent calls to simple_malloc
+ * @name    heap_free
+ * @brief   Return a block to the shared heap. Caller holds the heap lock.
  * @param   void *ptr Pointer to the memory to free.
+ *
+ * Both neighbours are found in constant time: the successor through the
+ * header, the predecessor through its footer when the prev-free bit is set.
  */
-void simple_free(void *ptr) {
-    if (ptr == NULL) return;
-
+static void heap_free(void *ptr) {
     // Find the block header corresponding to the user pointer
     BlockHeader *block_to_free = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
 
@@ -125,27 +988,1537 @@ void simple_free(void *ptr) {
         return;
     }
 
-    // Mark the block as free
-    SET_FREE(block_to_free, 1);
+#ifdef MM_RELEASE
+    uintptr_t freed_start = (uintptr_t)block_to_free, freed_end = (uintptr_t)GET_NEXT(block_to_free);
+    size_t neighbour = 0;
+#endif
 
     // Coalesce with the next block if it is free
     BlockHeader *next_block = GET_NEXT(block_to_free);
-    if (GET_FREE(next_block) && next_block != block_to_free) {  // Ensure we are not merging with itself
+    if (GET_FREE(next_block)) {
+#ifdef MM_RELEASE
+        neighbour = SIZE(next_block);
+#endif
         // Merge current block with the next free block
+        bin_remove(next_block);
         SET_NEXT(block_to_free, GET_NEXT(next_block));
+        coalesce_count++;
     }
 
     // Coalesce with the previous block if it is free
-    BlockHeader *prev_block = first;
-    while (prev_block != NULL && GET_NEXT(prev_block) != block_to_free) {
-        prev_block = GET_NEXT(prev_block);
-    }
-    if (prev_block != NULL && GET_FREE(prev_block) && prev_block != block_to_free) {  // Ensure valid previous block
+    if (GET_PREV_FREE(block_to_free)) {
+        BlockHeader *prev_block = GET_PREV(block_to_free);
+#ifdef MM_RELEASE
+        if (SIZE(prev_block) > neighbour) neighbour = SIZE(prev_block);
+#endif
         // Merge previous block with the current free block
+        bin_remove(prev_block);
         SET_NEXT(prev_block, GET_NEXT(block_to_free));
         block_to_free = prev_block;  // Update block_to_free to the merged block
+        coalesce_count++;
     }
 
+    // Mark the (merged) block as free and write its footer
+    mark_free(block_to_free);
+    bin_insert(block_to_free);
+#ifdef MM_RELEASE
+    release_free(block_to_free, freed_start, freed_end, neighbour);
+#endif
+
     // Update the `current` pointer to this block to optimize the next-fit strategy
     current = block_to_free;
 }
+
+/**
+ * @name    shrink_block
+ * @brief   Give the tail of an allocated block beyond `size` bytes back to the heap.
+ *
+ * Nothing happens when the tail is too small to form a block of its own.
+ */
+static void shrink_block(BlockHeader *block, size_t size) {
+    if (SIZE(block) - size < sizeof(BlockHeader) + MIN_SIZE) return;
+
+    // Split off the tail as an allocated block and free it, which coalesces it with a free successor
+    BlockHeader *tail = (BlockHeader *)((uintptr_t)block + sizeof(BlockHeader) + size);
+    SET_LINK(tail, GET_NEXT(block));
+    SET_PREV_FREE(tail, 0);
+    SET_FREE(tail, 0);
+    SET_NEXT(block, tail);
+    split_count++;
+    heap_free(tail->user_block);
+}
+
+/**
+ * @name    heap_resize
+ * @brief   Resize an allocated block in place. Caller holds the heap lock.
+ * @retval  1 if the block now holds at least `aligned_size` bytes, 0 if it has to move.
+ */
+static int heap_resize(BlockHeader *block, size_t aligned_size) {
+    if (aligned_size > SIZE(block)) {
+        // Grow by absorbing a free successor large enough to cover the difference
+        BlockHeader *next_block = GET_NEXT(block);
+        if (!GET_FREE(next_block) || SIZE(block) + sizeof(BlockHeader) + SIZE(next_block) < aligned_size) {
+            return 0;
+        }
+        bin_remove(next_block);
+        SET_NEXT(block, GET_NEXT(next_block));
+        SET_PREV_FREE(GET_NEXT(block), 0);
+        if (current == next_block) current = block;  // Never rove into the middle of a block
+        coalesce_count++;
+        mark_dirty(block);
+    }
+
+    shrink_block(block, aligned_size);
+    return 1;
+}
+
+/**
+ * @name    heap_memalign
+ * @brief   Allocate `aligned_size` bytes at a multiple of `alignment`. Caller holds the heap lock.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ *
+ * A block with room for the worst-case slack is allocated, then the slack in
+ * front of the aligned address is split off and freed and the excess tail is
+ * trimmed, so nothing is wasted beyond the usual rounding.
+ */
+static void *heap_memalign(size_t alignment, size_t aligned_size) {
+    size_t padded_size = aligned_size + alignment + sizeof(BlockHeader) + MIN_SIZE;
+    if (padded_size < aligned_size) return NULL;  // Overflow
+
+    void *ptr = heap_malloc(padded_size);
+    if (ptr == NULL) return NULL;
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+
+    // The slack must be either empty or large enough to become a free block
+    uintptr_t user = ((uintptr_t)ptr + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    while (user != (uintptr_t)ptr && user - (uintptr_t)ptr < sizeof(BlockHeader) + MIN_SIZE) {
+        user += alignment;
+    }
+
+    if (user != (uintptr_t)ptr) {
+        // Split at the aligned address and free the leading part
+        BlockHeader *aligned_block = (BlockHeader *)(user - sizeof(BlockHeader));
+        SET_LINK(aligned_block, GET_NEXT(block));
+        SET_PREV_FREE(aligned_block, 0);
+        SET_FREE(aligned_block, 0);
+        SET_NEXT(block, aligned_block);
+        split_count++;
+        heap_free(ptr);
+        block = aligned_block;
+    }
+
+    shrink_block(block, aligned_size);
+    return (void *)(block->user_block);
+}
+
+/**
+ * @name    heap_carve
+ * @brief   Allocate up to `n` consecutive blocks of `aligned_size` bytes from the free block `block`. Caller holds the heap lock.
+ * @retval  Number of blocks written to `out`, at least 1.
+ *
+ * Each header is written once, and the tail is split off or absorbed as in place().
+ */
+static size_t heap_carve(BlockHeader *block, size_t aligned_size, size_t n, void **out) {
+    size_t stride = sizeof(BlockHeader) + aligned_size;
+    size_t fit = (SIZE(block) + sizeof(BlockHeader)) / stride;
+    if (n > fit) n = fit;
+
+    BlockHeader *end = GET_NEXT(block);
+    bin_remove(block);
+    for (size_t i = 0; i + 1 < n; i++) {
+        BlockHeader *next = (BlockHeader *)((uintptr_t)block + stride);
+        SET_LINK(block, next);  // Allocated, preceded by an allocated block
+        out[i] = (void *)(block->user_block);
+        block = next;
+    }
+    out[n - 1] = (void *)(block->user_block);
+    split_count += n - 1;
+
+    // The last block takes the rest unless it is large enough to stand alone
+    if ((uintptr_t)end - (uintptr_t)block - stride < sizeof(BlockHeader) + MIN_SIZE) {
+        SET_LINK(block, end);
+        mark_allocated(block);
+    } else {
+        BlockHeader *tail = (BlockHeader *)((uintptr_t)block + stride);
+        SET_LINK(tail, end);
+        mark_free(tail);
+        bin_insert(tail);
+        SET_LINK(block, tail);
+        split_count++;
+    }
+    mark_dirty(block);
+
+    current = next_in_heap(block);
+    return n;
+}
+
+#ifdef MM_SLABS
+/*
+ * Headerless slabs for tiny requests: each size class of up to SLAB_MAX_SIZE
+ * bytes is served from page-sized slabs taken from the heap. A slab starts
+ * with a bitmap of its free slots, found with a count-trailing-zeros scan,
+ * and its objects carry no header at all. A page map with one bit per page
+ * of the managed region tells simple_free whether a pointer is in a slab.
+ *
+ * Slabs belong to a slab heap. With MM_THREADS every thread has its own, so
+ * slab allocation and frees by the owner need no lock; the heap lock is only
+ * taken to get or return a page. Other threads push the objects they free
+ * onto the owner's remote list with a compare-and-swap, and the owner takes
+ * the whole list with one exchange before its next slab allocation. The heap
+ * of an exited thread is adopted by the next thread that needs one.
+ */
+#define SLAB_SIZE      4096                       // Bytes per slab, also its alignment
+#define SLAB_BYTES     (SLAB_SIZE - sizeof(BlockHeader))  // Usable part, the next block header takes the last word
+#define SLAB_MAX_SIZE  64                         // Largest request served from slabs
+#define SLAB_CLASSES   (SLAB_MAX_SIZE / 8 + 1)    // One class per multiple of 8 bytes
+#define SLAB_WORDS     (SLAB_SIZE / 8 / 64)       // Bitmap words for the most slots a slab can have
+#define SLAB_MAP_WORDS ((MEMORY_MAX_SIZE + SLAB_SIZE) / SLAB_SIZE / 64 + 1)
+
+typedef struct slab_heap {
+    struct slab *partial[SLAB_CLASSES]; // Slabs with at least one free slot, per class
+    uint64_t objects;                   // Live objects in these slabs, written only by the owner
+    struct slab_heap *next;             // Every slab heap, for simple_mm_stats
+#ifdef MM_THREADS
+    void *remote;                       // Objects freed by other threads, linked through their first word
+    int abandoned;                      // The owner has exited, protected by the heap lock
+#endif
+} SlabHeap;
+
+typedef struct slab {
+    struct slab *next;             // Slabs of the same class with free slots
+    struct slab *prev;
+    SlabHeap *owner;
+    uint32_t slot_size;
+    uint32_t free_count;
+    uint32_t capacity;
+    uint64_t free_bits[SLAB_WORDS]; // Bit set for each free slot
+    uint64_t slots[0];              // Empty array to ensure alignment of the first slot
+} Slab;
+
+static uint64_t slab_map[SLAB_MAP_WORDS];  // Bit set for each page of the region that is a slab
+static uint64_t slab_count = 0;            // Protected by the heap lock, like slab_floor and slab_heaps
+static BlockHeader *slab_floor = NULL;     // Lowest slab block stacked below the sentinel, NULL for none
+
+#ifdef MM_THREADS
+static SlabHeap *slab_heaps = NULL;
+static _Thread_local SlabHeap *slab_heap_local = NULL;  // Slab heap of the calling thread
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_key;
+#else
+static SlabHeap slab_heap_main;
+static SlabHeap *slab_heaps = &slab_heap_main;
+#endif
+
+/**
+ * @name    slab_page
+ * @brief   Index of the page holding `ptr` in the page map, or SIZE_MAX outside the managed region.
+ */
+static size_t slab_page(const void *ptr) {
+    uintptr_t p = (uintptr_t)ptr;
+    // Frees reach this without the heap lock, while heap_extend may be moving the end
+    if (p < memory_start || p >= __atomic_load_n(&memory_end, __ATOMIC_ACQUIRE)) return SIZE_MAX;
+    return (p - (memory_start & ~(uintptr_t)(SLAB_SIZE - 1))) / SLAB_SIZE;
+}
+
+/**
+ * @name    slab_of
+ * @brief   The slab holding `ptr`, or NULL if `ptr` belongs to a heap block or a mapping.
+ *
+ * A live pointer's page cannot change between slab and heap, so no lock is needed.
+ */
+static Slab *slab_of(const void *ptr) {
+    size_t page = slab_page(ptr);
+    if (page == SIZE_MAX) return NULL;
+    uint64_t word = __atomic_load_n(&slab_map[page / 64], __ATOMIC_RELAXED);
+    return (word >> (page % 64)) & 1 ? (Slab *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1)) : NULL;
+}
+
+/**
+ * @name    slab_mark
+ * @brief   Set or clear the page map bit of a slab.
+ */
+static void slab_mark(Slab *slab, int is_slab) {
+    size_t page = slab_page(slab);
+    if (is_slab) {
+        __atomic_fetch_or(&slab_map[page / 64], 1ull << (page % 64), __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&slab_map[page / 64], ~(1ull << (page % 64)), __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @name    slab_link
+ * @brief   Put a slab at the front of the partial list of its class.
+ */
+static void slab_link(Slab *slab) {
+    unsigned cls = slab->slot_size >> 3;
+    slab->prev = NULL;
+    slab->next = slab->owner->partial[cls];
+    if (slab->next != NULL) slab->next->prev = slab;
+    slab->owner->partial[cls] = slab;
+}
+
+/**
+ * @name    slab_unlink
+ * @brief   Remove a slab from the partial list of its class.
+ */
+static void slab_unlink(Slab *slab) {
+    if (slab->next != NULL) slab->next->prev = slab->prev;
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        slab->owner->partial[slab->slot_size >> 3] = slab->next;
+    }
+}
+
+/**
+ * @name    slab_above
+ * @brief   The slab block the stack continues from once the floor slab `block` is released, or NULL for the sentinel.
+ *
+ * The floor has to stay a slab, any other block could be freed under it.
+ */
+static BlockHeader *slab_above(BlockHeader *block) {
+    BlockHeader *above = GET_NEXT(block);
+    if (GET_FREE(above)) above = GET_NEXT(above);  // Free blocks are never neighbours
+    if (above == sentinel || slab_of(above->user_block) == NULL) return NULL;
+    return above;
+}
+
+/**
+ * @name    slab_block
+ * @brief   A page-aligned heap block of SLAB_BYTES bytes for a new slab. Caller holds the heap lock.
+ *
+ * Slabs are stacked downwards from the sentinel, each cut from the top of
+ * the free block below the previous one while it has room. This keeps them
+ * out of the way of the placement policies and leaves no alignment gap
+ * behind; the odd end of the region above the first page stays in its
+ * block. Otherwise heap_memalign finds a page.
+ */
+static void *slab_block(void) {
+    if (first == NULL) simple_init();
+    if (first == NULL) return NULL;
+
+    BlockHeader *floor = (slab_floor != NULL) ? slab_floor : sentinel;
+    if (GET_PREV_FREE(floor)) {
+        BlockHeader *below = GET_PREV(floor);
+        uintptr_t start = ((uintptr_t)floor + sizeof(BlockHeader) - SLAB_SIZE) & ~(uintptr_t)(SLAB_SIZE - 1);
+        BlockHeader *block = (BlockHeader *)(start - sizeof(BlockHeader));
+        if ((uintptr_t)block >= (uintptr_t)below + sizeof(BlockHeader) + MIN_SIZE) {
+            // The free block keeps its bottom part, the rest up to the floor becomes the slab block
+            bin_remove(below);
+            SET_LINK(block, floor);
+            SET_NEXT(below, block);
+            mark_free(below);
+            bin_insert(below);
+            SET_PREV_FREE(floor, 0);
+            split_count++;
+            if ((uintptr_t)block < clean_end) clean_end = (uintptr_t)block;
+            slab_floor = block;
+            return block->user_block;
+        }
+    }
+    return heap_memalign(SLAB_SIZE, SLAB_BYTES);
+}
+
+/**
+ * @name    slab_create
+ * @brief   Take a page-aligned block from the heap and format it as an empty slab of `heap`. Caller holds the heap lock.
+ * @retval  The slab, already on the partial list, or NULL if the heap is full.
+ */
+static Slab *slab_create(SlabHeap *heap, size_t slot_size) {
+    Slab *slab = slab_block();
+    if (slab == NULL) return NULL;
+
+    slab->owner = heap;
+    slab->slot_size = (uint32_t)slot_size;
+    slab->capacity = (uint32_t)((SLAB_BYTES - sizeof(Slab)) / slot_size);
+    slab->free_count = slab->capacity;
+    memset(slab->free_bits, 0, sizeof(slab->free_bits));
+    for (uint32_t word = 0; word < slab->capacity / 64; word++) slab->free_bits[word] = ~0ull;
+    if (slab->capacity % 64 != 0) slab->free_bits[slab->capacity / 64] = (1ull << (slab->capacity % 64)) - 1;
+
+    slab_mark(slab, 1);
+    slab_link(slab);
+    slab_count++;
+    return slab;
+}
+
+/**
+ * @name    slab_free_local
+ * @brief   Return an object to its slab. Caller owns the slab heap.
+ *
+ * An empty slab goes back to the heap unless it is the only one of its class
+ * with free slots, which saves a page round trip on alternating malloc and free.
+ */
+static void slab_free_local(Slab *slab, void *ptr) {
+    size_t slot = ((uintptr_t)ptr - (uintptr_t)slab->slots) / slab->slot_size;
+    uint64_t mask = 1ull << (slot % 64);
+    if (slab->free_bits[slot / 64] & mask) {
+        printf("Warning: Attempting to free an already free block at address %p.\n", ptr);
+        return;
+    }
+    slab->free_bits[slot / 64] |= mask;
+    __atomic_store_n(&slab->owner->objects, slab->owner->objects - 1, __ATOMIC_RELAXED);
+
+    if (slab->free_count++ == 0) slab_link(slab);
+    if (slab->free_count == slab->capacity && (slab->prev != NULL || slab->next != NULL)) {
+        slab_unlink(slab);
+        slab_mark(slab, 0);
+        HEAP_LOCK();
+        slab_count--;
+        if ((BlockHeader *)slab - 1 == slab_floor) slab_floor = slab_above(slab_floor);
+        heap_free(slab);
+        HEAP_UNLOCK();
+    }
+}
+
+#ifdef MM_THREADS
+/**
+ * @name    slab_drain
+ * @brief   Free the objects other threads pushed onto the remote list of `heap`. Caller owns the heap.
+ */
+static void slab_drain(SlabHeap *heap) {
+    if (__atomic_load_n(&heap->remote, __ATOMIC_RELAXED) == NULL) return;  // No atomic write when empty
+
+    void *ptr = __atomic_exchange_n(&heap->remote, NULL, __ATOMIC_ACQUIRE);
+    while (ptr != NULL) {
+        void *next = *(void **)ptr;
+        slab_free_local(slab_of(ptr), ptr);
+        ptr = next;
+    }
+}
+
+/**
+ * @name    slab_abandon
+ * @brief   Thread exit destructor leaving the slab heap of the thread to the next thread that needs one.
+ *
+ * Slabs keep their live objects; frees of them queue up on the remote list
+ * until the heap is adopted.
+ */
+static void slab_abandon(void *arg) {
+    SlabHeap *heap = arg;
+    slab_drain(heap);
+    HEAP_LOCK();
+    heap->abandoned = 1;
+    HEAP_UNLOCK();
+    slab_heap_local = NULL;
+}
+
+static void slab_create_key(void) {
+    pthread_key_create(&slab_key, slab_abandon);
+}
+#endif
+
+/**
+ * @name    slab_heap_get
+ * @brief   The slab heap of the calling thread, adopting or creating one on first use.
+ * @retval  The heap or NULL if there was no memory for it.
+ */
+static SlabHeap *slab_heap_get(void) {
+#ifdef MM_THREADS
+    if (slab_heap_local != NULL) return slab_heap_local;
+
+    pthread_once(&slab_once, slab_create_key);
+    HEAP_LOCK();
+    SlabHeap *heap = slab_heaps;
+    while (heap != NULL && !heap->abandoned) heap = heap->next;
+    if (heap != NULL) {
+        heap->abandoned = 0;
+    } else if ((heap = heap_malloc(align_size(sizeof(SlabHeap)))) != NULL) {
+        // Slab heaps are never freed, a remote free may still be on its way to one
+        memset(heap, 0, sizeof(SlabHeap));
+        heap->next = slab_heaps;
+        slab_heaps = heap;
+    }
+    HEAP_UNLOCK();
+    if (heap == NULL) return NULL;
+
+    pthread_setspecific(slab_key, heap);
+    slab_heap_local = heap;
+    return heap;
+#else
+    return &slab_heap_main;
+#endif
+}
+
+/**
+ * @name    slab_alloc
+ * @brief   Allocate one object of `slot_size` bytes, a multiple of 8, from the slab heap of the caller.
+ * @retval  Pointer to the object or NULL if no slab could be created.
+ */
+static void *slab_alloc(size_t slot_size) {
+    SlabHeap *heap = slab_heap_get();
+    if (heap == NULL) return NULL;
+#ifdef MM_THREADS
+    slab_drain(heap);
+#endif
+
+    Slab *slab = heap->partial[slot_size >> 3];
+    if (slab == NULL) {
+        HEAP_LOCK();
+        slab = slab_create(heap, slot_size);
+        HEAP_UNLOCK();
+        if (slab == NULL) return NULL;
+    }
+
+    // The first non-zero bitmap word holds the lowest free slot
+    unsigned word = 0;
+    while (slab->free_bits[word] == 0) word++;
+    unsigned bit = __builtin_ctzll(slab->free_bits[word]);
+    slab->free_bits[word] &= slab->free_bits[word] - 1;
+
+    if (--slab->free_count == 0) slab_unlink(slab);
+    __atomic_store_n(&heap->objects, heap->objects + 1, __ATOMIC_RELAXED);
+    return (void *)((uintptr_t)slab->slots + (word * 64 + bit) * slab->slot_size);
+}
+
+/**
+ * @name    slab_free
+ * @brief   Free an object of `slab`, on the remote list of its owner if that is another thread.
+ */
+static void slab_free(Slab *slab, void *ptr) {
+#ifdef MM_THREADS
+    SlabHeap *owner = slab->owner;  // Fixed for the life of the slab, which holds ptr
+    if (owner != slab_heap_local) {
+        void *head = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+        do {
+            if (head == ptr) {
+                printf("Warning: Attempting to free an already free block at address %p.\n", ptr);
+                return;
+            }
+            *(void **)ptr = head;
+        } while (!__atomic_compare_exchange_n(&owner->remote, &head, ptr, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        return;
+    }
+#endif
+    slab_free_local(slab, ptr);
+}
+
+/**
+ * @name    slab_size
+ * @brief   Slot size a request of `size` bytes is served with, or 0 if it is too large for a slab.
+ */
+static size_t slab_size(size_t size) {
+    if (size > SLAB_MAX_SIZE) return 0;
+    return size == 0 ? 8 : (size + 7) & ~7;
+}
+#endif
+
+#ifdef MM_THREADS
+/*
+ * Concurrent mode: the heap above is shared and protected by one lock, while
+ * each thread keeps a small cache of blocks per size class. Cached blocks stay
+ * marked allocated in the heap, so any thread may free into its own cache no
+ * matter which thread allocated the block, and hits never touch the lock.
+ */
+#define TCACHE_MAX_SIZE 256                       // Largest user block kept in a thread cache
+#define TCACHE_CLASSES  (TCACHE_MAX_SIZE / 8 + 1) // One class per multiple of 8 bytes
+#define TCACHE_LIMIT    32                        // Blocks cached per class before frees go to the heap
+#define TCACHE_REFILL   8                         // Blocks taken from the heap per lock acquisition
+
+typedef struct thread_cache {
+    BlockHeader *head[TCACHE_CLASSES];   // Cached blocks, linked through their first user word
+    uint16_t count[TCACHE_CLASSES];
+    int registered;                      // Set once the exit destructor knows about this cache
+} ThreadCache;
+
+#define CACHE_NEXT(p) (*(BlockHeader **)(p)->user_block) // Link to the next cached block
+
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;
+static _Thread_local ThreadCache tcache;
+
+/**
+ * @name    tcache_flush
+ * @brief   Thread exit destructor returning every cached block to the heap.
+ */
+static void tcache_flush(void *arg) {
+    ThreadCache *cache = arg;
+    HEAP_LOCK();
+    for (unsigned cls = 0; cls < TCACHE_CLASSES; cls++) {
+        while (cache->head[cls] != NULL) {
+            BlockHeader *block = cache->head[cls];
+            cache->head[cls] = CACHE_NEXT(block);
+            heap_free(block->user_block);
+        }
+        cache->count[cls] = 0;
+    }
+    HEAP_UNLOCK();
+}
+
+static void tcache_create_key(void) {
+    pthread_key_create(&tcache_key, tcache_flush);
+}
+
+/**
+ * @name    tcache_push
+ * @brief   Cache a block of the calling thread. Returns 0 if the class is full.
+ */
+static int tcache_push(BlockHeader *block, unsigned cls) {
+    if (tcache.count[cls] >= TCACHE_LIMIT) return 0;
+    CACHE_NEXT(block) = tcache.head[cls];
+    tcache.head[cls] = block;
+    tcache.count[cls]++;
+    return 1;
+}
+
+/**
+ * @name    tcache_refill
+ * @brief   Move up to TCACHE_REFILL blocks of class `cls` from the heap into the cache.
+ */
+static void tcache_refill(unsigned cls) {
+    if (!tcache.registered) {
+        pthread_once(&tcache_once, tcache_create_key);
+        pthread_setspecific(tcache_key, &tcache);
+        tcache.registered = 1;
+    }
+
+    HEAP_LOCK();
+    for (unsigned n = 0; n < TCACHE_REFILL; n++) {
+#ifdef MM_QUICKLISTS
+        void *ptr = quick_pop(cls << 3);
+        if (ptr == NULL) ptr = heap_malloc(cls << 3);
+#else
+        void *ptr = heap_malloc(cls << 3);
+#endif
+        if (ptr == NULL) break;
+        BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+        CACHE_NEXT(block) = tcache.head[cls];
+        tcache.head[cls] = block;
+        tcache.count[cls]++;
+    }
+    HEAP_UNLOCK();
+}
+#endif
+
+/**
+ * @name    page_round
+ * @brief   Round a length up to a whole number of pages.
+ */
+static size_t page_round(size_t length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (length + page - 1) & ~(page - 1);
+}
+
+/**
+ * @name    mmap_alloc
+ * @brief   Serve a large request from a mapping of its own, outside the block list.
+ * @retval  Pointer to the user block (zero-filled) or NULL if the kernel refused.
+ *
+ * The header holds the length of the mapping instead of a next pointer.
+ */
+static void *mmap_alloc(size_t aligned_size) {
+    size_t length = page_round(aligned_size + sizeof(BlockHeader));
+    if (length < aligned_size) return NULL;  // Overflow
+
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+
+    BlockHeader *block = base;
+    block->next = (BlockHeader *)(length | MMAPPED_MASK);
+    __atomic_fetch_add(&mmapped_blocks, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mmapped_bytes, length, __ATOMIC_RELAXED);
+    return (void *)(block->user_block);
+}
+
+/**
+ * @name    mmap_free
+ * @brief   Return a mapped block to the kernel right away.
+ */
+static void mmap_free(BlockHeader *block) {
+    size_t length = MMAP_LENGTH(block->next);
+    __atomic_fetch_sub(&mmapped_blocks, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&mmapped_bytes, length, __ATOMIC_RELAXED);
+    munmap(block, length);
+}
+
+/**
+ * @name    mmap_realloc
+ * @brief   Resize a mapped block with mremap, which moves pages instead of copying them.
+ * @retval  Pointer to the user block or NULL if the kernel refused, in which case the block is untouched.
+ */
+static void *mmap_realloc(BlockHeader *block, size_t aligned_size) {
+    size_t old_length = MMAP_LENGTH(block->next);
+    size_t length = page_round(aligned_size + sizeof(BlockHeader));
+    if (length == old_length) return (void *)(block->user_block);
+
+    BlockHeader *moved = mremap(block, old_length, length, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) return NULL;
+
+    moved->next = (BlockHeader *)(length | MMAPPED_MASK);
+    __atomic_fetch_add(&mmapped_bytes, length - old_length, __ATOMIC_RELAXED);
+    return (void *)(moved->user_block);
+}
+
+/**
+ * @name    simple_set_mmap_threshold
+ * @brief   Serve requests of at least `threshold` bytes from dedicated mappings; 0 disables this.
+ * @retval  The previous threshold.
+ */
+size_t simple_set_mmap_threshold(size_t threshold) {
+    return __atomic_exchange_n(&mmap_threshold, threshold, __ATOMIC_RELAXED);
+}
+
+#ifdef MM_RELEASE
+/**
+ * @name    simple_set_release_threshold
+ * @brief   Give free pages back only in ranges of at least `threshold` bytes, starting the adaptation afresh.
+ * @retval  The previous threshold.
+ */
+size_t simple_set_release_threshold(size_t threshold) {
+    HEAP_LOCK();
+    size_t previous = release_threshold;
+    release_threshold = threshold;
+    release_held = 0;
+    release_last_start = release_last_end = 0;  // Earlier releases no longer raise it
+    HEAP_UNLOCK();
+    return previous;
+}
+#endif
+
+/**
+ * @name    large_request
+ * @brief   Whether a request bypasses the heap for a mapping of its own.
+ */
+static int large_request(size_t aligned_size) {
+#ifdef MM_SHARED
+    return 0;  // A mapping of its own would be private to this process
+#endif
+    size_t threshold = __atomic_load_n(&mmap_threshold, __ATOMIC_RELAXED);
+    return threshold != 0 && aligned_size >= threshold;
+}
+
+#ifdef MM_PROFILE
+/*
+ * Profiling mode: every request made through the public functions is counted
+ * by size, and each freed block adds its lifetime, the number of allocations
+ * made while it was live. A realloc counts as a free and a new request. The
+ * profile is written by simple_mm_profile_write and at exit to the file named
+ * by SIMPLE_MM_PROFILE; size_classes turns it into mm_classes.h.
+ */
+#define PROFILE_EXACT   4096                       // Sizes up to here are counted per multiple of 8 bytes
+#define PROFILE_BUCKETS (PROFILE_EXACT / 8 + 64)   // Then one bucket per power of two
+#define PROFILE_SLOTS   (1 << 20)                  // Live blocks whose birth can be tracked, a power of two
+#define PROFILE_ENV     "SIMPLE_MM_PROFILE"
+
+typedef struct profile_bucket {
+    uint64_t requests;
+    uint64_t frees;
+    uint64_t lifetime;        // Sum over the freed blocks
+} ProfileBucket;
+
+typedef struct profile_slot {
+    uintptr_t ptr;            // Live block, 0 for an empty slot
+    uint64_t birth;           // Allocation clock when it was handed out
+    uint64_t bucket;
+} ProfileSlot;
+
+static ProfileBucket profile_buckets[PROFILE_BUCKETS];
+static ProfileSlot profile_live[PROFILE_SLOTS];  // Open addressing with linear probing
+static uint64_t profile_live_count = 0;
+static uint64_t profile_clock = 0;
+static uint64_t profile_untracked = 0;           // Requests whose lifetime was lost because the table was full
+
+#ifdef MM_THREADS
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;  // Protects everything above
+#define PROFILE_LOCK()   pthread_mutex_lock(&profile_lock)
+#define PROFILE_UNLOCK() pthread_mutex_unlock(&profile_lock)
+#else
+#define PROFILE_LOCK()   ((void)0)
+#define PROFILE_UNLOCK() ((void)0)
+#endif
+
+/**
+ * @name    profile_bucket
+ * @brief   Bucket counting requests of `size` bytes.
+ */
+static unsigned profile_bucket(size_t size) {
+    if (size <= PROFILE_EXACT) return (unsigned)((size + 7) >> 3);
+    return PROFILE_EXACT / 8 + (64 - __builtin_clzll(size - 1)) - __builtin_ctzll(PROFILE_EXACT);
+}
+
+/**
+ * @name    profile_slot
+ * @brief   Slot a block hashes to in the table of live blocks.
+ */
+static size_t profile_slot(uintptr_t ptr) {
+    return (size_t)(((ptr >> 3) * 0x9e3779b97f4a7c15ull) >> 32) & (PROFILE_SLOTS - 1);
+}
+
+/**
+ * @name    profile_alloc
+ * @brief   Count a request of `size` bytes that returned `ptr`.
+ * @retval  `ptr`, so a return statement can be wrapped.
+ */
+static void *profile_alloc(void *ptr, size_t size) {
+    if (ptr == NULL) return NULL;
+    unsigned bucket = profile_bucket(size);
+
+    PROFILE_LOCK();
+    profile_buckets[bucket].requests++;
+    profile_clock++;
+    if (2 * (profile_live_count + 1) > PROFILE_SLOTS) {
+        profile_untracked++;
+    } else {
+        size_t slot = profile_slot((uintptr_t)ptr);
+        while (profile_live[slot].ptr != 0) slot = (slot + 1) & (PROFILE_SLOTS - 1);
+        profile_live[slot].ptr = (uintptr_t)ptr;
+        profile_live[slot].birth = profile_clock;
+        profile_live[slot].bucket = bucket;
+        profile_live_count++;
+    }
+    PROFILE_UNLOCK();
+    return ptr;
+}
+
+/**
+ * @name    profile_free
+ * @brief   Count the free of `ptr` and its lifetime.
+ *
+ * Later entries of the probe run are shifted back, so no tombstones are needed.
+ */
+static void profile_free(void *ptr) {
+    if (ptr == NULL) return;
+    size_t mask = PROFILE_SLOTS - 1;
+
+    PROFILE_LOCK();
+    size_t slot = profile_slot((uintptr_t)ptr);
+    while (profile_live[slot].ptr != (uintptr_t)ptr) {
+        if (profile_live[slot].ptr == 0) {
+            PROFILE_UNLOCK();
+            return;  // Untracked block, or a bad free the allocator will warn about
+        }
+        slot = (slot + 1) & mask;
+    }
+    ProfileBucket *bucket = &profile_buckets[profile_live[slot].bucket];
+    bucket->frees++;
+    bucket->lifetime += profile_clock - profile_live[slot].birth;
+
+    for (size_t next = (slot + 1) & mask; profile_live[next].ptr != 0; next = (next + 1) & mask) {
+        // An entry may fill the hole if its home slot is not between the hole and itself
+        size_t home = profile_slot(profile_live[next].ptr);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            profile_live[slot] = profile_live[next];
+            slot = next;
+        }
+    }
+    profile_live[slot].ptr = 0;
+    profile_live_count--;
+    PROFILE_UNLOCK();
+}
+
+/**
+ * @name    profile_batch
+ * @brief   Count the `done` blocks of a batch allocation of `size` bytes each.
+ * @retval  `done`, so a return statement can be wrapped.
+ */
+static size_t profile_batch(void *out[], size_t done, size_t size) {
+    for (size_t i = 0; i < done; i++) profile_alloc(out[i], size);
+    return done;
+}
+
+#define PROFILED(ptr, size)             profile_alloc(ptr, size)
+#define PROFILED_BATCH(out, done, size) profile_batch(out, done, size)
+#define PROFILE_FREE(ptr)               profile_free(ptr)
+#else
+#define PROFILED(ptr, size)             (ptr)
+#define PROFILED_BATCH(out, done, size) (done)
+#define PROFILE_FREE(ptr)               ((void)0)
+#endif
+
+/**
+ * @name    simple_malloc
+ * @brief   Allocate at least `size` contiguous bytes of memory and return a pointer to the first byte.
+ * @param   size_t size Number of bytes to allocate.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ */
+void *simple_malloc(size_t size) {
+    size_t aligned_size = align_size(size);
+    if (large_request(aligned_size)) return PROFILED(mmap_alloc(aligned_size), size);
+
+#ifdef MM_SLABS
+    size_t slot_size = slab_size(size);
+    if (slot_size != 0) return PROFILED(slab_alloc(slot_size), size);
+#endif
+
+#ifdef MM_THREADS
+    if (aligned_size <= TCACHE_MAX_SIZE) {
+        unsigned cls = aligned_size >> 3;
+        if (tcache.head[cls] == NULL) tcache_refill(cls);
+
+        BlockHeader *block = tcache.head[cls];
+        if (block == NULL) return NULL;
+        tcache.head[cls] = CACHE_NEXT(block);
+        tcache.count[cls]--;
+        return PROFILED((void *)(block->user_block), size);
+    }
+#endif
+
+    HEAP_LOCK();
+#ifdef MM_QUICKLISTS
+    void *ptr = quick_pop(aligned_size);
+    if (ptr == NULL) ptr = heap_malloc(aligned_size);
+#else
+    void *ptr = heap_malloc(aligned_size);
+#endif
+    HEAP_UNLOCK();
+    return PROFILED(ptr, size);
+}
+
+/**
+ * @name    simple_free
+ * @brief   Frees previously allocated memory and makes it available for subsequent calls to simple_malloc
+ * @param   void *ptr Pointer to the memory to free.
+ */
+void simple_free(void *ptr) {
+    if (ptr == NULL) return;
+    PROFILE_FREE(ptr);
+
+#ifdef MM_SLABS
+    Slab *slab = slab_of(ptr);
+    if (slab != NULL) {
+        slab_free(slab, ptr);
+        return;
+    }
+#endif
+
+    // Other threads may flip the prev-free bit under the lock, but the other
+    // bits of an allocated block only change when its owner frees it
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+    uintptr_t word = (uintptr_t)__atomic_load_n(&block->next, __ATOMIC_RELAXED);
+    if (IS_MMAPPED(word)) {
+        mmap_free(block);
+        return;
+    }
+
+#ifdef MM_THREADS
+    size_t size = (uintptr_t)FROM_WORD(word & ~FLAG_MASK) - (uintptr_t)block - sizeof(BlockHeader);
+    if (size <= TCACHE_MAX_SIZE && !(word & FREE_MASK) && tcache_push(block, size >> 3)) return;
+#endif
+
+    HEAP_LOCK();
+#ifdef MM_QUICKLISTS
+    if (!quick_push(block)) heap_free(ptr);
+#else
+    heap_free(ptr);
+#endif
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_realloc
+ * @brief   Resize previously allocated memory, keeping its contents up to the smaller of the two sizes.
+ * @param   void *ptr Pointer to the memory to resize, or NULL to allocate.
+ * @param   size_t size New size in bytes, or 0 to free.
+ * @retval  Pointer to the resized memory or NULL if not possible, in which case ptr is untouched.
+ *
+ * The block grows in place into a free successor and shrinks in place by
+ * splitting off its tail; only when neither works is it copied.
+ */
+void *simple_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) return simple_malloc(size);
+    if (size == 0) {
+        simple_free(ptr);
+        return NULL;
+    }
+
+    size_t aligned_size = align_size(size);
+
+#ifdef MM_SLABS
+    Slab *slab = slab_of(ptr);
+    if (slab != NULL) {
+        if (size <= slab->slot_size) {
+            PROFILE_FREE(ptr);
+            return PROFILED(ptr, size);
+        }
+        void *new_ptr = simple_malloc(size);
+        if (new_ptr == NULL) return NULL;
+        memcpy(new_ptr, ptr, slab->slot_size);
+        simple_free(ptr);
+        return new_ptr;
+    }
+#endif
+
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+    if (IS_MMAPPED(__atomic_load_n(&block->next, __ATOMIC_RELAXED))) {
+        void *new_ptr = mmap_realloc(block, aligned_size);
+        return (new_ptr == NULL) ? NULL : (PROFILE_FREE(ptr), PROFILED(new_ptr, size));
+    }
+
+    HEAP_LOCK();
+    int resized = heap_resize(block, aligned_size);
+    size_t old_size = SIZE(block);
+    HEAP_UNLOCK();
+    if (resized) {
+        PROFILE_FREE(ptr);
+        return PROFILED(ptr, size);
+    }
+
+    // Move the contents to a new block
+    void *new_ptr = simple_malloc(size);
+    if (new_ptr == NULL) return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    simple_free(ptr);
+    return new_ptr;
+}
+
+/**
+ * @name    simple_memalign
+ * @brief   Allocate at least `size` bytes at an address that is a multiple of `alignment`.
+ * @param   size_t alignment A power of two.
+ * @param   size_t size Number of bytes to allocate.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ */
+void *simple_memalign(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) return NULL;
+    if (alignment <= 8) return simple_malloc(size);  // Every block is 8-byte aligned
+
+    HEAP_LOCK();
+    void *ptr = heap_memalign(alignment, align_size(size));
+    HEAP_UNLOCK();
+    return PROFILED(ptr, size);
+}
+
+/**
+ * @name    simple_usable_size
+ * @brief   Bytes that may be used at `ptr`: the whole user block, slot or mapping it was given.
+ * @retval  The usable size, 0 for NULL.
+ */
+size_t simple_usable_size(void *ptr) {
+    if (ptr == NULL) return 0;
+
+#ifdef MM_SLABS
+    Slab *slab = slab_of(ptr);
+    if (slab != NULL) return slab->slot_size;
+#endif
+
+    // The owner of a block is the only one to change where it ends, neighbours only touch its flags
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+    BlockHeader *word = __atomic_load_n(&block->next, __ATOMIC_RELAXED);
+    if (IS_MMAPPED(word)) return MMAP_LENGTH(word) - sizeof(BlockHeader);
+    return (uintptr_t)FROM_WORD((uintptr_t)word & ~FLAG_MASK) - (uintptr_t)ptr;
+}
+
+/**
+ * @name    simple_calloc
+ * @brief   Allocate zero-filled memory for an array of `nmemb` elements of `size` bytes.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ *
+ * Only the parts of the block below clean_start and above clean_end are
+ * cleared; the region is zero when memory_setup.c provides it and stays so
+ * until first handed out.
+ */
+void *simple_calloc(size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > SIZE_MAX / size) return NULL;  // Overflow
+    size_t total = nmemb * size;
+    if (large_request(align_size(total))) return PROFILED(mmap_alloc(align_size(total)), total);  // Fresh mappings are zero
+
+#ifdef MM_SLABS
+    if (slab_size(total) != 0) {
+        void *ptr = simple_malloc(total);
+        if (ptr != NULL) memset(ptr, 0, total);
+        return ptr;
+    }
+#endif
+
+    // Read the clean mark together with the allocation so no other thread can dirty the block in between
+    HEAP_LOCK();
+    uintptr_t clean = clean_start, top = clean_end;
+#ifdef MM_GROWABLE
+    uintptr_t old_end = memory_end;
+#endif
+    uint8_t *ptr = heap_malloc(align_size(total));
+#ifdef MM_GROWABLE
+    int grown = (memory_end != old_end);
+#endif
+    HEAP_UNLOCK();
+    if (ptr == NULL) return NULL;
+
+    uintptr_t end = (uintptr_t)ptr + total;
+    if ((uintptr_t)ptr < clean) {
+        memset(ptr, 0, (end < clean ? end : clean) - (uintptr_t)ptr);
+    }
+
+#ifdef MM_GROWABLE
+    // Growing the heap freed the old sentinel, with the footer before it and the links after it, into the block
+    if (grown) {
+        uintptr_t from = old_end - FREE_HEAD_SIZE, to = old_end + FREE_HEAD_SIZE;
+        if (from < (uintptr_t)ptr) from = (uintptr_t)ptr;
+        if (to > end) to = end;
+        if (from < to) memset((void *)from, 0, to - from);
+    }
+#endif
+
+    // The block may end at the sentinel, where the footer of the last free block lived
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+    uintptr_t footer = (uintptr_t)FOOTER(block);
+    if (footer >= clean && footer < end) {
+        memset((void *)footer, 0, (end - footer < sizeof(BlockHeader *)) ? end - footer : sizeof(BlockHeader *));
+    }
+
+    // Slabs may have used the memory at the top of the heap
+    if (end > top) {
+        uintptr_t from = (uintptr_t)ptr > top ? (uintptr_t)ptr : top;
+        memset((void *)from, 0, end - from);
+    }
+    return PROFILED(ptr, total);
+}
+
+/**
+ * @name    simple_malloc_batch
+ * @brief   Allocate `n` blocks of at least `size` bytes each, storing them in `out`.
+ * @retval  Number of blocks allocated; the first that many entries of `out` are set.
+ *
+ * The blocks are cut back to back from as few free blocks as possible under
+ * one lock acquisition, which makes them adjacent for simple_free_batch.
+ */
+size_t simple_malloc_batch(size_t size, size_t n, void *out[]) {
+    size_t aligned_size = align_size(size);
+    size_t done = 0;
+    if (large_request(aligned_size)) {
+        while (done < n && (out[done] = mmap_alloc(aligned_size)) != NULL) done++;
+        return PROFILED_BATCH(out, done, size);
+    }
+
+#ifdef MM_SLABS
+    size_t slot_size = slab_size(size);
+    if (slot_size != 0) {
+        while (done < n && (out[done] = slab_alloc(slot_size)) != NULL) done++;
+        return PROFILED_BATCH(out, done, size);
+    }
+#endif
+
+    HEAP_LOCK();
+    if (first == NULL) simple_init();
+    while (done < n && first != NULL) {
+        uint64_t visited = 0;
+#ifdef MM_QUICKLISTS
+        if (aligned_size >= QUICK_LARGE) quick_flush();
+#endif
+        BlockHeader *block = find_fit(aligned_size, &visited);
+#ifdef MM_QUICKLISTS
+        if (block == NULL && quick_flush()) block = find_fit(aligned_size, &visited);
+#endif
+        record_search(visited);
+#ifdef MM_GROWABLE
+        if (block == NULL) block = heap_extend(aligned_size);
+#endif
+        if (block == NULL) break;
+        done += heap_carve(block, aligned_size, n - done, out + done);
+    }
+    HEAP_UNLOCK();
+    return PROFILED_BATCH(out, done, size);
+}
+
+/**
+ * @name    compare_addresses
+ * @brief   qsort comparator ordering pointers by address.
+ */
+static int compare_addresses(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(void *const *)a;
+    uintptr_t y = (uintptr_t)*(void *const *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @name    simple_free_batch
+ * @brief   Free the `n` blocks in `ptrs`, which is sorted by address in place. NULL entries are skipped.
+ *
+ * Blocks that are neighbours in the heap are joined first and freed as one,
+ * so a run costs a single coalescing step and free-list insertion.
+ */
+void simple_free_batch(void *ptrs[], size_t n) {
+#ifdef MM_PROFILE
+    for (size_t i = 0; i < n; i++) profile_free(ptrs[i]);
+#endif
+#ifdef MM_SLABS
+    // Slab objects have no header to join with, and their frees take no heap lock
+    for (size_t i = 0; i < n; i++) {
+        Slab *slab = slab_of(ptrs[i]);
+        if (slab != NULL) {
+            slab_free(slab, ptrs[i]);
+            ptrs[i] = NULL;
+        }
+    }
+#endif
+
+    // Batches usually come in allocation order or its reverse, which need no qsort
+    size_t rises = 0;
+    for (size_t i = 1; i < n; i++) rises += (uintptr_t)ptrs[i] > (uintptr_t)ptrs[i - 1];
+    if (rises == 0) {
+        for (size_t lo = 0, hi = n; lo + 1 < hi; lo++, hi--) {
+            void *tmp = ptrs[lo];
+            ptrs[lo] = ptrs[hi - 1];
+            ptrs[hi - 1] = tmp;
+        }
+    } else if (rises < n - 1) {
+        qsort(ptrs, n, sizeof(void *), compare_addresses);
+    }
+    size_t i = 0;
+    while (i < n && ptrs[i] == NULL) i++;  // NULL sorts first
+
+    HEAP_LOCK();
+    for (; i < n; i++) {
+        BlockHeader *block = (BlockHeader *)((uintptr_t)ptrs[i] - sizeof(BlockHeader));
+        if (IS_MMAPPED(block->next)) {
+            mmap_free(block);
+            continue;
+        }
+
+        // Absorb the following entries while they are the allocated successor of the run
+        while (!GET_FREE(block) && i + 1 < n) {
+            BlockHeader *next = (BlockHeader *)((uintptr_t)ptrs[i + 1] - sizeof(BlockHeader));
+            if (GET_NEXT(block) != next || GET_FREE(next)) break;
+            SET_NEXT(block, GET_NEXT(next));
+            coalesce_count++;
+            i++;
+        }
+        heap_free(block->user_block);  // Warns if the block was already free
+    }
+    HEAP_UNLOCK();
+}
+
+#ifdef MM_HANDLES
+/*
+ * Relocatable blocks: a handle names an entry of the handle table, which
+ * holds the block currently backing it. The first word of such a block keeps
+ * the handle, so a walk over the heap recognizes the block as the one the
+ * table points back to. Blocks that are not pinned may be slid down into a
+ * free predecessor by the compactor, which rebuilds large free blocks at the
+ * cost of invalidating the pointers of unpinned handles.
+ */
+#define HANDLE_TABLE_INITIAL 1024   // Entries mapped for the first handles, doubled as needed
+
+typedef struct handle_entry {
+    BlockHeader *block;       // Block backing the handle, NULL while the entry is unused
+    uint32_t pins;            // The block must not move while this is non-zero
+    uint32_t next_unused;     // Next unused entry, 0 ends the list
+} HandleEntry;
+
+#define HANDLE_OF(p) (*(uint64_t *)(p)->user_block) // Handle stored in the first word of its block
+
+static HandleEntry *handle_table = NULL;  // Mapped outside the heap so growing it never fragments the heap
+static uint32_t handle_capacity = 0;
+static uint32_t handle_count = 1;         // Entries handed out so far, entry 0 is never used
+static uint32_t handle_unused = 0;        // Entries freed since, linked through next_unused
+
+/**
+ * @name    handle_take
+ * @brief   Find an unused entry of the handle table, growing it if needed. Caller holds the heap lock.
+ * @retval  The entry index or 0 if the table cannot grow.
+ */
+static uint32_t handle_take(void) {
+    if (handle_unused != 0) {
+        uint32_t index = handle_unused;
+        handle_unused = handle_table[index].next_unused;
+        return index;
+    }
+
+    if (handle_count >= handle_capacity) {
+        uint32_t capacity = handle_capacity ? 2 * handle_capacity : HANDLE_TABLE_INITIAL;
+        if (capacity <= handle_capacity) return 0;  // Out of 32-bit handles
+        void *table = (handle_table == NULL)
+            ? mmap(NULL, capacity * sizeof(HandleEntry), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+            : mremap(handle_table, handle_capacity * sizeof(HandleEntry), capacity * sizeof(HandleEntry), MREMAP_MAYMOVE);
+        if (table == MAP_FAILED) return 0;
+        handle_table = table;
+        handle_capacity = capacity;
+    }
+    return handle_count++;
+}
+
+/**
+ * @name    handle_entry
+ * @brief   Entry of a live handle, or NULL if `handle` is not one.
+ */
+static HandleEntry *handle_entry(SimpleHandle handle) {
+    if (handle == 0 || handle >= handle_count || handle_table[handle].block == NULL) return NULL;
+    return &handle_table[handle];
+}
+
+/**
+ * @name    handle_slide
+ * @brief   Move an allocated block down into the free block before it. Caller holds the heap lock.
+ * @retval  The block at its new address.
+ *
+ * The free space ends up behind the block, where it merges with a free successor.
+ */
+static BlockHeader *handle_slide(BlockHeader *block) {
+    BlockHeader *prev = GET_PREV(block);
+    BlockHeader *next = GET_NEXT(block);
+    size_t size = SIZE(block);
+
+    // The predecessor of a free block is allocated, so the moved block starts with clear flags
+    bin_remove(prev);
+    memmove(prev->user_block, block->user_block, size);
+    BlockHeader *hole = (BlockHeader *)((uintptr_t)prev + sizeof(BlockHeader) + size);
+    SET_LINK(prev, hole);
+
+    SET_LINK(hole, next);
+    if (GET_FREE(next)) {
+        bin_remove(next);
+        SET_NEXT(hole, GET_NEXT(next));
+        coalesce_count++;
+    }
+    mark_free(hole);
+    bin_insert(hole);
+    current = hole;
+    return prev;
+}
+
+/**
+ * @name    handle_compact
+ * @brief   Slide unpinned handle blocks down over the free blocks before them. Caller holds the heap lock.
+ * @retval  Bytes moved.
+ *
+ * One pass from the start of the heap, stopping once `budget` bytes have moved.
+ */
+static size_t handle_compact(size_t budget) {
+    size_t moved = 0;
+#ifdef MM_QUICKLISTS
+    quick_flush();  // Deferred frees would stand in the way like allocated blocks
+#endif
+    for (BlockHeader *block = first; block != NULL && GET_NEXT(block) != NULL && moved < budget;
+         block = GET_NEXT(block)) {
+        if (GET_FREE(block) || !GET_PREV_FREE(block)) continue;
+
+        HandleEntry *entry = handle_entry((SimpleHandle)HANDLE_OF(block));
+        if (entry == NULL || entry->block != block || entry->pins != 0) continue;
+        block = handle_slide(block);
+        entry->block = block;
+        moved += SIZE(block);
+    }
+    return moved;
+}
+
+/**
+ * @name    simple_handle_alloc
+ * @brief   Allocate a relocatable block of at least `size` bytes.
+ * @retval  Its handle, or 0 if not possible even after compacting the heap.
+ */
+SimpleHandle simple_handle_alloc(size_t size) {
+    if (size > SIZE_MAX - 2 * sizeof(uint64_t)) return 0;  // Overflow
+    size_t aligned_size = align_size(size + sizeof(uint64_t));
+
+    HEAP_LOCK();
+    uint32_t index = handle_take();
+    void *ptr = NULL;
+    if (index != 0) {
+        ptr = heap_malloc(aligned_size);
+        if (ptr == NULL && handle_compact(SIZE_MAX) != 0) ptr = heap_malloc(aligned_size);
+        if (ptr == NULL) {
+            handle_table[index].next_unused = handle_unused;
+            handle_unused = index;
+        }
+    }
+    if (ptr == NULL) {
+        HEAP_UNLOCK();
+        return 0;
+    }
+
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+    HANDLE_OF(block) = index;
+    handle_table[index].block = block;
+    handle_table[index].pins = 0;
+    HEAP_UNLOCK();
+    return index;
+}
+
+/**
+ * @name    simple_handle_pin
+ * @brief   Pin the block of `handle` so it cannot move, and return its address.
+ * @retval  Pointer to the user data, valid until the matching unpin, or NULL for an invalid handle.
+ */
+void *simple_handle_pin(SimpleHandle handle) {
+    HEAP_LOCK();
+    HandleEntry *entry = handle_entry(handle);
+    void *ptr = NULL;
+    if (entry != NULL) {
+        entry->pins++;
+        ptr = (void *)(entry->block->user_block + 1);
+    }
+    HEAP_UNLOCK();
+    return ptr;
+}
+
+/**
+ * @name    simple_handle_unpin
+ * @brief   Undo one simple_handle_pin. Once every pin is undone the block may move again.
+ */
+void simple_handle_unpin(SimpleHandle handle) {
+    HEAP_LOCK();
+    HandleEntry *entry = handle_entry(handle);
+    if (entry != NULL && entry->pins > 0) entry->pins--;
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_handle_free
+ * @brief   Free the block of `handle`, pinned or not. The handle becomes invalid and may be reused.
+ */
+void simple_handle_free(SimpleHandle handle) {
+    HEAP_LOCK();
+    HandleEntry *entry = handle_entry(handle);
+    if (entry == NULL) {
+        HEAP_UNLOCK();
+        printf("Warning: Attempting to free an invalid handle %u.\n", handle);
+        return;
+    }
+    heap_free(entry->block->user_block);
+    entry->block = NULL;
+    entry->next_unused = handle_unused;
+    handle_unused = handle;
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_handle_compact
+ * @brief   Slide unpinned handle blocks together, moving at most about `budget` bytes; 0 means no limit.
+ * @retval  Bytes moved.
+ */
+size_t simple_handle_compact(size_t budget) {
+    HEAP_LOCK();
+    size_t moved = handle_compact(budget ? budget : SIZE_MAX);
+    HEAP_UNLOCK();
+    return moved;
+}
+#endif
+
+/**
+ * @name    simple_mm_stats
+ * @brief   Fill `stats` with a snapshot of the heap.
+ *
+ * Byte and block totals come from one walk over the heap here, so the
+ * allocation paths only pay for the event counters.
+ */
+void simple_mm_stats(SimpleStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    HEAP_LOCK();
+    for (BlockHeader *block = first; block != NULL && GET_NEXT(block) != NULL; block = GET_NEXT(block)) {
+        size_t size = SIZE(block);
+        if (GET_FREE(block)) {
+            stats->bytes_free += size;
+            stats->blocks_free++;
+            if (size > stats->largest_free) stats->largest_free = size;
+        } else {
+            stats->bytes_in_use += size;
+            stats->blocks_in_use++;
+        }
+    }
+    memcpy(stats->search_histogram, search_histogram, sizeof(search_histogram));
+    stats->splits = split_count;
+    stats->coalesces = coalesce_count;
+#ifdef MM_QUICKLISTS
+    stats->quick_blocks = quick_blocks;
+#endif
+#ifdef MM_RELEASE
+    stats->released_bytes = released_bytes;
+    stats->release_threshold = release_threshold;
+#endif
+#ifdef MM_SLABS
+    stats->slabs = slab_count;
+    for (SlabHeap *heap = slab_heaps; heap != NULL; heap = heap->next) {
+        stats->slab_objects += __atomic_load_n(&heap->objects, __ATOMIC_RELAXED);
+    }
+#endif
+    HEAP_UNLOCK();
+
+    stats->mmapped_blocks = __atomic_load_n(&mmapped_blocks, __ATOMIC_RELAXED);
+    stats->mmapped_bytes = __atomic_load_n(&mmapped_bytes, __ATOMIC_RELAXED);
+
+    if (stats->bytes_free > 0) {
+        stats->fragmentation = 1.0 - (double)stats->largest_free / (double)stats->bytes_free;
+    }
+}
+
+/**
+ * @name    simple_set_fit
+ * @brief   Select the placement policy used by subsequent allocations.
+ */
+void simple_set_fit(SimpleFit fit) {
+    HEAP_LOCK();
+    fit_policy = fit;
+    HEAP_UNLOCK();
+}
+
+#ifdef MM_THREADS
+/**
+ * @name    simple_fork_prepare
+ * @brief   Take every lock of the allocator, so no other thread holds one while the process forks.
+ */
+void simple_fork_prepare(void) {
+#ifdef MM_PROFILE
+    PROFILE_LOCK();
+#endif
+    HEAP_LOCK();
+}
+
+/**
+ * @name    simple_fork_parent
+ * @brief   Release the locks taken by simple_fork_prepare in the parent.
+ */
+void simple_fork_parent(void) {
+    HEAP_UNLOCK();
+#ifdef MM_PROFILE
+    PROFILE_UNLOCK();
+#endif
+}
+
+/**
+ * @name    simple_fork_child
+ * @brief   Reset the locks in the child, where only the forking thread exists.
+ *
+ * The caches of the other threads are lost with them; their blocks stay allocated.
+ */
+void simple_fork_child(void) {
+    pthread_mutex_init(&heap_lock, NULL);
+#ifdef MM_PROFILE
+    pthread_mutex_init(&profile_lock, NULL);
+#endif
+}
+#endif
+
+/**
+ * @name    simple_mm_profile_write
+ * @brief   Write the allocation profile recorded so far to `path`.
+ * @retval  0 on success, -1 if the file could not be written or the allocator was built without MM_PROFILE.
+ *
+ * One line per size: the largest request size counted in the bucket, then
+ * the number of requests, of frees, and the sum of the lifetimes of the freed
+ * blocks, measured in allocations.
+ */
+int simple_mm_profile_write(const char *path) {
+#ifdef MM_PROFILE
+    FILE *file = fopen(path, "w");
+    if (file == NULL) return -1;
+
+    PROFILE_LOCK();
+    fprintf(file, "# simple_mm profile: size requests frees lifetime\n");
+    fprintf(file, "# %llu allocations, %llu without lifetime\n", (unsigned long long)profile_clock,
+            (unsigned long long)profile_untracked);
+    for (unsigned bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+        ProfileBucket *b = &profile_buckets[bucket];
+        if (b->requests == 0) continue;
+        unsigned long long size = (bucket <= PROFILE_EXACT / 8) ? bucket * 8ull
+                                : (unsigned long long)PROFILE_EXACT << (bucket - PROFILE_EXACT / 8);
+        fprintf(file, "%llu %llu %llu %llu\n", size, (unsigned long long)b->requests,
+                (unsigned long long)b->frees, (unsigned long long)b->lifetime);
+    }
+    PROFILE_UNLOCK();
+    return fclose(file) == 0 ? 0 : -1;
+#else
+    return -1;
+#endif
+}
+
+#ifdef MM_PROFILE
+/**
+ * @name    profile_at_exit
+ * @brief   Write the profile to the file named by SIMPLE_MM_PROFILE, if any, when the program exits.
+ */
+__attribute__((destructor)) static void profile_at_exit(void) {
+    const char *path = getenv(PROFILE_ENV);
+    if (path != NULL && path[0] != '\0') simple_mm_profile_write(path);
+}
+#endif
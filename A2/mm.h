@@ -6,9 +6,16 @@
  *
  */
 
+#ifndef MM_H_
+#define MM_H_
+
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 /**
  * @name    simple_malloc
@@ -25,6 +32,314 @@ void * simple_malloc(size_t size);
 void simple_free(void * ptr);
 
 
+/**
+ * @name    simple_realloc
+ * @brief   Resize previously allocated memory, in place when possible, keeping its contents.
+ * @retval  Pointer to the resized memory or NULL if not possible, in which case ptr is still valid.
+ */
+void * simple_realloc(void * ptr, size_t size);
+
+
+/**
+ * @name    simple_memalign
+ * @brief   Allocate at least size bytes at an address that is a multiple of alignment (a power of two).
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ */
+void * simple_memalign(size_t alignment, size_t size);
+
+
+/**
+ * @name    simple_calloc
+ * @brief   Allocate zero-filled memory for an array of nmemb elements of size bytes each.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ */
+void * simple_calloc(size_t nmemb, size_t size);
+
+
+/**
+ * @name    simple_usable_size
+ * @brief   Bytes that may be used at ptr, a block returned by the functions above; at least as many as asked for.
+ * @retval  The usable size, 0 for NULL.
+ */
+size_t simple_usable_size(void * ptr);
+
+
+/**
+ * @name    simple_malloc_batch
+ * @brief   Allocate n blocks of at least size bytes each into out[], cut back to back under one lock.
+ * @retval  Number of blocks allocated; only that many leading entries of out are set.
+ */
+size_t simple_malloc_batch(size_t size, size_t n, void * out[]);
+
+
+/**
+ * @name    simple_free_batch
+ * @brief   Free the n blocks in ptrs[], joining heap neighbours before freeing them.
+ *          ptrs is sorted by address in place; NULL entries are skipped.
+ */
+void simple_free_batch(void * ptrs[], size_t n);
+
+
+/**
+ * @name    SimpleFit
+ * @brief   Placement policies for simple_set_fit. With MM_SEGLIST they apply within the size-class bins;
+ *          with MM_TREE every allocation takes the best fit.
+ */
+typedef enum mm_fit {
+    MM_FIT_NEXT,    // First block that fits, searching on from the previous allocation (default)
+    MM_FIT_FIRST,   // First block that fits, searching from the start of the heap
+    MM_FIT_BEST,    // Smallest block that fits, searching the whole heap
+    MM_FIT_GOOD     // Smallest block among a bounded number examined after the first fit
+} SimpleFit;
+
+
+/**
+ * @name    simple_set_fit
+ * @brief   Select the placement policy for subsequent allocations. Build with -DMM_DEFAULT_FIT to change the default.
+ */
+void simple_set_fit(SimpleFit fit);
+
+
+/**
+ * @name    simple_set_mmap_threshold
+ * @brief   Serve requests of at least threshold bytes from their own mapping, unmapped again on free.
+ *          0 (the default unless built with -DMM_MMAP_THRESHOLD) keeps every request in the heap.
+ * @retval  The previous threshold.
+ */
+size_t simple_set_mmap_threshold(size_t threshold);
+
+
+#ifdef MM_RELEASE
+/**
+ * @name    simple_set_release_threshold
+ * @brief   Give free pages back to the kernel only in ranges of at least threshold bytes, rounded to whole pages.
+ *          The allocator still raises it while released pages keep being reused, and lowers it again later.
+ * @retval  The previous threshold.
+ */
+size_t simple_set_release_threshold(size_t threshold);
+#endif
+
+
+#ifdef MM_THREADS
+/**
+ * @name    simple_fork_prepare, simple_fork_parent, simple_fork_child
+ * @brief   pthread_atfork handlers: take the allocator's locks before fork, release them in the parent
+ *          and reset them in the child, so the child cannot inherit a lock another thread held.
+ */
+void simple_fork_prepare(void);
+void simple_fork_parent(void);
+void simple_fork_child(void);
+#endif
+
+
+#define MM_SEARCH_BUCKETS 16
+
+/**
+ * @name    SimpleStats
+ * @brief   Heap usage and allocator event counters, see simple_mm_stats.
+ */
+typedef struct mm_stats {
+    size_t bytes_in_use;        // User bytes in allocated blocks (including blocks held in thread caches)
+    size_t bytes_free;          // User bytes in free blocks
+    size_t blocks_in_use;       // Number of allocated blocks
+    size_t blocks_free;         // Number of free blocks
+    size_t largest_free;        // User bytes of the largest free block
+    double fragmentation;       // External fragmentation, 1 - largest_free / bytes_free
+    uint64_t search_histogram[MM_SEARCH_BUCKETS]; // Searches by blocks visited: bucket b counts [2^(b-1), 2^b), bucket 0 counts none
+    uint64_t splits;            // Blocks split since start
+    uint64_t coalesces;         // Blocks merged with a neighbour since start
+    size_t mmapped_blocks;      // Live blocks served by their own mapping, not counted above
+    size_t mmapped_bytes;       // Bytes mapped for those blocks
+    size_t slabs;               // Slabs for tiny objects (MM_SLABS), each counted above as one block in use
+    size_t slab_objects;        // Live objects in those slabs, and remote frees their owner has not taken back yet
+    size_t quick_blocks;        // Freed blocks waiting on the quick lists (MM_QUICKLISTS), counted above as in use
+    uint64_t released_bytes;    // Bytes of free pages given back to the kernel since start, again when a block grows (MM_RELEASE)
+    size_t release_threshold;   // Smallest range of free pages given back now, raised while they keep being reused (MM_RELEASE)
+} SimpleStats;
+
+
+/**
+ * @name    simple_mm_stats
+ * @brief   Fill stats with a snapshot of the heap. Walks the whole heap, the counters themselves are always on.
+ */
+void simple_mm_stats(SimpleStats * stats);
+
+
+/**
+ * @name    simple_mm_profile_write
+ * @brief   Write the sizes and lifetimes of the requests made so far to `path`, one line per size.
+ * @retval  0 on success, -1 on a write error or if the allocator was built without MM_PROFILE.
+ *
+ * With MM_PROFILE the profile is also written at exit to the file named by
+ * SIMPLE_MM_PROFILE. size_classes turns profiles into mm_classes.h.
+ */
+int simple_mm_profile_write(const char * path);
+
+
+#ifdef MM_HANDLES
+
+/* Names a relocatable block, 0 is never a valid handle */
+typedef uint32_t SimpleHandle;
+
+/**
+ * @name    simple_handle_alloc
+ * @brief   Allocate a block of at least size bytes that the compactor may move while it is not pinned.
+ * @retval  Its handle, or 0 if not possible even after compacting the heap.
+ */
+SimpleHandle simple_handle_alloc(size_t size);
+
+
+/**
+ * @name    simple_handle_pin
+ * @brief   Keep the block of handle in place and return its address. Pins nest.
+ * @retval  Pointer to the memory, valid until the matching unpin, or NULL for an invalid handle.
+ */
+void * simple_handle_pin(SimpleHandle handle);
+
+
+/**
+ * @name    simple_handle_unpin
+ * @brief   Undo one simple_handle_pin; pointers obtained from it must not be used afterwards.
+ */
+void simple_handle_unpin(SimpleHandle handle);
+
+
+/**
+ * @name    simple_handle_free
+ * @brief   Free the block of handle. The handle may be returned again by a later simple_handle_alloc.
+ */
+void simple_handle_free(SimpleHandle handle);
+
+
+/**
+ * @name    simple_handle_compact
+ * @brief   Slide unpinned handle blocks down over free blocks, moving at most about budget bytes (0: no limit).
+ * @retval  Bytes moved. Calls with a small budget spread the work over time.
+ */
+size_t simple_handle_compact(size_t budget);
+
+#endif
+
+#ifdef MM_SHARED
+/**
+ * @name    simple_shared_attach
+ * @brief   Use the POSIX shared memory object name (e.g. "/my_heap") as the heap, creating it with size
+ *          bytes if it does not exist. Every process attaching the same name allocates from and frees
+ *          into one heap. Without a call, the first allocation attaches an unnamed region of
+ *          MEMORY_MAX_SIZE bytes, shared with the children forked afterwards.
+ * @retval  0 on success, -1 if a heap is attached already or the object could not be mapped.
+ */
+int simple_shared_attach(const char * name, size_t size);
+
+
+/**
+ * @name    simple_shared_detach
+ * @brief   Unmap the heap from this process; remove a named object with shm_unlink once no process needs it.
+ */
+void simple_shared_detach(void);
+
+
+/**
+ * @name    simple_shared_offset
+ * @brief   Position of ptr in the heap, valid in every attached process. Store these instead of
+ *          pointers in shared structures, as each process may map the heap at another address.
+ * @retval  The offset, 0 for NULL.
+ */
+uint64_t simple_shared_offset(const void * ptr);
+
+
+/**
+ * @name    simple_shared_pointer
+ * @brief   Address in this process of an offset from simple_shared_offset, NULL for 0.
+ */
+void * simple_shared_pointer(uint64_t offset);
+
+
+/**
+ * @name    simple_shared_set_root
+ * @brief   Publish one block for the other processes to find, e.g. the head of a shared structure.
+ */
+void simple_shared_set_root(const void * ptr);
+
+
+/**
+ * @name    simple_shared_root
+ * @brief   The block last published with simple_shared_set_root by any process, or NULL.
+ */
+void * simple_shared_root(void);
+
+#endif
+
+#ifdef MM_GROWABLE
+
+#define MEMORY_MAX_SIZE (16ull * 1024 * 1024 * 1024)  // Address space reserved, nothing committed up front
+
+/**
+ * @name    The lowest address of the memory you will manage
+ * @brief   Start of the reserved address space, set by memory_reserve
+ */
+extern uintptr_t memory_start;
+
+
+/**
+ * @name    The limit of the memory you will manage
+ * @brief   First address that is not committed yet, moved up by memory_grow
+ */
+extern uintptr_t memory_end;
+
+
+/**
+ * @name    memory_reserve
+ * @brief   Reserve the address space of the heap and commit its first initial bytes.
+ * @retval  0 on success, -1 on failure.
+ */
+int memory_reserve(size_t initial);
+
+
+/**
+ * @name    memory_grow
+ * @brief   Commit at least size more bytes directly after memory_end.
+ * @retval  0 on success, -1 if the reservation is exhausted.
+ */
+int memory_grow(size_t size);
+
+#elif defined(MM_SHARED)
+
+#define MEMORY_MAX_SIZE (32 * 1024 * 1024)  // Size of the unnamed region attached on first use
+
+/**
+ * @name    The lowest address of the memory you will manage
+ * @brief   Where this process mapped the shared region, set by memory_attach
+ */
+extern uintptr_t memory_start;
+
+
+/**
+ * @name    The limit of the memory you will manage
+ * @brief   First address after the shared region
+ */
+extern uintptr_t memory_end;
+
+
+/**
+ * @name    memory_attach
+ * @brief   Map the POSIX shared memory object name, creating it with size bytes if it does not exist.
+ *          A NULL name maps an unnamed region of size bytes, shared with children forked later.
+ * @retval  1 if the region was created, 0 if an existing one was mapped, -1 on failure.
+ */
+int memory_attach(const char * name, size_t size);
+
+
+/**
+ * @name    memory_detach
+ * @brief   Unmap the region mapped by memory_attach.
+ */
+void memory_detach(void);
+
+#else
+
+#define MEMORY_MAX_SIZE (32 * 1024 * 1024)  // 32 MB
+
 /**
  * @name    The lowest address of the memory you will manage
  * @brief   This points to the lowest address of memory you will manage
@@ -38,4 +353,10 @@ extern const uintptr_t memory_start;
  */
 extern const uintptr_t memory_end;
 
+#endif
+
+#ifdef __cplusplus
+}
+#endif
 
+#endif /* MM_H_ */
@@ -0,0 +1,150 @@
+/**
+ * @file   mm_allocator.hpp
+ * @brief  C++ allocators that put standard containers in the managed memory.
+ *
+ * Header only, on top of mm.h, mm_pool.h and mm_arena.h:
+ *
+ *   simple_mm::Allocator<T>       simple_malloc and simple_free, stateless
+ *   simple_mm::NodeAllocator<T>   single objects from a pool per node size,
+ *                                 for std::list, std::map and std::set
+ *   simple_mm::ArenaAllocator<T>  bump allocation from a SimpleArena, freed
+ *                                 all at once by simple_arena_reset
+ *
+ * e.g. std::map<int, int, std::less<int>, simple_mm::NodeAllocator<std::pair<const int, int> > >.
+ * Like the pools and arenas underneath, NodeAllocator and ArenaAllocator
+ * must only be used by one thread at a time.
+ */
+
+#ifndef MM_ALLOCATOR_HPP_
+#define MM_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include "mm.h"
+#include "mm_pool.h"
+#include "mm_arena.h"
+
+namespace simple_mm {
+
+/**
+ * @name    allocate_aligned
+ * @brief   simple_malloc for objects of type T, or simple_memalign when T needs more than 8-byte alignment.
+ * @retval  The memory; throws std::bad_alloc if the heap is full.
+ */
+template <class T>
+T *allocate_aligned(std::size_t n) {
+    if (n > static_cast<std::size_t>(-1) / sizeof(T)) throw std::bad_alloc();
+    void *ptr = (alignof(T) > 8) ? simple_memalign(alignof(T), n * sizeof(T)) : simple_malloc(n * sizeof(T));
+    if (ptr == NULL) throw std::bad_alloc();
+    return static_cast<T *>(ptr);
+}
+
+/* Stateless allocator over simple_malloc and simple_free */
+template <class T>
+class Allocator {
+public:
+    typedef T value_type;
+
+    Allocator() {}
+    template <class U> Allocator(const Allocator<U> &) {}
+
+    T *allocate(std::size_t n) { return allocate_aligned<T>(n); }
+    void deallocate(T *ptr, std::size_t) { simple_free(ptr); }
+};
+
+template <class T, class U>
+bool operator==(const Allocator<T> &, const Allocator<U> &) { return true; }
+template <class T, class U>
+bool operator!=(const Allocator<T> &, const Allocator<U> &) { return false; }
+
+/**
+ * @name    NodePool
+ * @brief   The pool shared by every node type of `Size` bytes, created on first use and never destroyed.
+ */
+template <std::size_t Size>
+struct NodePool {
+    static SimplePool *get() {
+        static SimplePool *pool = simple_pool_create(Size);
+        return pool;
+    }
+};
+
+/*
+ * Node-based containers allocate one node at a time, and the node type is
+ * only known once the container rebinds the allocator. Single objects then
+ * come from the pool for sizeof(T), chosen at compile time, so they carry no
+ * header and cost O(1); arrays, such as the buckets of an unordered_map, and
+ * over-aligned types go to simple_malloc.
+ */
+template <class T>
+class NodeAllocator {
+public:
+    typedef T value_type;
+
+    NodeAllocator() {}
+    template <class U> NodeAllocator(const NodeAllocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        if (n != 1 || alignof(T) > 8) return allocate_aligned<T>(n);
+        SimplePool *pool = NodePool<sizeof(T)>::get();
+        void *ptr = (pool != NULL) ? simple_pool_alloc(pool) : NULL;
+        if (ptr == NULL) throw std::bad_alloc();
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T *ptr, std::size_t n) {
+        if (n != 1 || alignof(T) > 8) {
+            simple_free(ptr);
+        } else {
+            simple_pool_free(NodePool<sizeof(T)>::get(), ptr);
+        }
+    }
+};
+
+template <class T, class U>
+bool operator==(const NodeAllocator<T> &, const NodeAllocator<U> &) { return true; }
+template <class T, class U>
+bool operator!=(const NodeAllocator<T> &, const NodeAllocator<U> &) { return false; }
+
+/*
+ * Allocator over an arena owned by the caller. deallocate does nothing: the
+ * memory comes back when the arena is restored or reset, which must not
+ * happen while a container still uses it.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(SimpleArena *arena) : arena_(arena) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    T *allocate(std::size_t n) {
+        if (n > (static_cast<std::size_t>(-1) - alignof(T)) / sizeof(T)) throw std::bad_alloc();
+
+        // The arena aligns to 8 bytes, over-aligned types ask for slack and round up
+        std::size_t slack = (alignof(T) > 8) ? alignof(T) - 8 : 0;
+        void *ptr = simple_arena_alloc(arena_, n * sizeof(T) + slack);
+        if (ptr == NULL) throw std::bad_alloc();
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+        address = (address + alignof(T) - 1) & ~static_cast<std::uintptr_t>(alignof(T) - 1);
+        return reinterpret_cast<T *>(address);
+    }
+
+    void deallocate(T *, std::size_t) {}
+
+    SimpleArena *arena() const { return arena_; }
+
+private:
+    SimpleArena *arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() == b.arena(); }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() != b.arena(); }
+
+} // namespace simple_mm
+
+#endif /* MM_ALLOCATOR_HPP_ */
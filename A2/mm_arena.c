@@ -0,0 +1,150 @@
+/**
+ * @file   mm_arena.c
+ * @brief  Bump-pointer arenas carved out of the managed memory.
+ */
+
+#include <stdint.h>
+#include "mm.h"
+#include "mm_arena.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)  // Bytes requested from simple_malloc per chunk
+
+/* Each chunk starts with a link to the previously filled chunk */
+typedef struct chunk {
+    struct chunk *next;
+    size_t size;              // Bytes of the whole chunk, including this header
+    uint64_t data[0];         // Empty array to ensure alignment of the first object
+} Chunk;
+
+struct simple_arena {
+    Chunk *chunks;            // Chunks in use, the one being filled first
+    Chunk *oldest;            // Last chunk of that list, so a reset can splice it in O(1)
+    Chunk *spare;             // Chunks freed by a reset or restore, kept for reuse
+    uintptr_t bump;           // Next free byte in the chunk being filled
+    uintptr_t bump_end;       // End of that chunk
+};
+
+/**
+ * @name    simple_arena_create
+ * @brief   Create an empty arena.
+ * @retval  Pointer to the arena or NULL if there is no memory for it.
+ */
+SimpleArena *simple_arena_create(void) {
+    SimpleArena *arena = simple_malloc(sizeof(SimpleArena));
+    if (arena == NULL) return NULL;
+
+    arena->chunks = NULL;
+    arena->oldest = NULL;
+    arena->spare = NULL;
+    arena->bump = 0;
+    arena->bump_end = 0;
+    return arena;
+}
+
+/**
+ * @name    arena_grow
+ * @brief   Start filling a chunk with room for `size` bytes, a spare one if it is large enough.
+ * @retval  0 on success, -1 if simple_malloc failed.
+ */
+static int arena_grow(SimpleArena *arena, size_t size) {
+    Chunk *chunk = arena->spare;
+    if (chunk != NULL && chunk->size >= sizeof(Chunk) + size) {
+        arena->spare = chunk->next;
+    } else {
+        // Requests larger than a chunk get one of their own size
+        size_t chunk_size = ARENA_CHUNK_SIZE;
+        if (chunk_size < sizeof(Chunk) + size) chunk_size = sizeof(Chunk) + size;
+        chunk = simple_malloc(chunk_size);
+        if (chunk == NULL) return -1;
+        chunk->size = chunk_size;
+    }
+
+    if (arena->chunks == NULL) arena->oldest = chunk;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->bump = (uintptr_t)chunk->data;
+    arena->bump_end = (uintptr_t)chunk + chunk->size;
+    return 0;
+}
+
+/**
+ * @name    simple_arena_alloc
+ * @brief   Allocate size bytes from the arena.
+ * @retval  Pointer to the memory (8-byte aligned) or NULL if no chunk could be allocated.
+ */
+void *simple_arena_alloc(SimpleArena *arena, size_t size) {
+    if (size > SIZE_MAX - sizeof(Chunk) - ARENA_CHUNK_SIZE) return NULL;  // Overflow
+    size = (size + 7) & ~(size_t)7;
+    if (size > arena->bump_end - arena->bump) {
+        if (arena_grow(arena, size) != 0) return NULL;
+    }
+    void *ptr = (void *)arena->bump;
+    arena->bump += size;
+    return ptr;
+}
+
+/**
+ * @name    simple_arena_save
+ * @brief   Remember the current position of the arena. Marks nest like a stack.
+ */
+SimpleArenaMark simple_arena_save(SimpleArena *arena) {
+    SimpleArenaMark mark = { arena->chunks, arena->bump };
+    return mark;
+}
+
+/**
+ * @name    simple_arena_restore
+ * @brief   Free everything allocated since `mark` was saved.
+ *
+ * Chunks filled since the mark move to the spare list.
+ */
+void simple_arena_restore(SimpleArena *arena, SimpleArenaMark mark) {
+    while (arena->chunks != mark.chunk) {
+        Chunk *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        chunk->next = arena->spare;
+        arena->spare = chunk;
+    }
+
+    if (arena->chunks == NULL) {
+        arena->oldest = NULL;
+        arena->bump = 0;
+        arena->bump_end = 0;
+    } else {
+        arena->bump = mark.bump;
+        arena->bump_end = (uintptr_t)arena->chunks + arena->chunks->size;
+    }
+}
+
+/**
+ * @name    simple_arena_reset
+ * @brief   Free everything allocated from the arena in O(1). Its chunks are kept for reuse.
+ */
+void simple_arena_reset(SimpleArena *arena) {
+    if (arena->chunks != NULL) {
+        // Put the whole list in front of the spare chunks
+        arena->oldest->next = arena->spare;
+        arena->spare = arena->chunks;
+    }
+    arena->chunks = NULL;
+    arena->oldest = NULL;
+    arena->bump = 0;
+    arena->bump_end = 0;
+}
+
+/**
+ * @name    simple_arena_destroy
+ * @brief   Return every chunk of the arena to the heap and free the arena itself.
+ */
+void simple_arena_destroy(SimpleArena *arena) {
+    if (arena == NULL) return;
+
+    simple_arena_reset(arena);
+    Chunk *chunk = arena->spare;
+    while (chunk != NULL) {
+        Chunk *next = chunk->next;
+        simple_free(chunk);
+        chunk = next;
+    }
+    simple_free(arena);
+}
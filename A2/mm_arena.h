@@ -0,0 +1,80 @@
+/**
+ * @file   mm_arena.h
+ * @brief  Arenas for data that is thrown away all at once, on top of the memory management subsystem.
+ *
+ * An arena hands out memory by bumping a pointer through chunks obtained
+ * with simple_malloc. Objects cannot be freed one by one; instead a mark
+ * saved with simple_arena_save can be restored to free everything allocated
+ * since, and simple_arena_reset frees everything in O(1). An arena must only
+ * be used by one thread at a time.
+ */
+
+#ifndef MM_ARENA_H_
+#define MM_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct simple_arena SimpleArena;
+
+/* A position in an arena, returned by simple_arena_save */
+typedef struct simple_arena_mark {
+    void *chunk;              // Chunk being filled when the mark was saved, NULL if there was none
+    uintptr_t bump;           // Next free byte in that chunk
+} SimpleArenaMark;
+
+
+/**
+ * @name    simple_arena_create
+ * @brief   Create an empty arena.
+ * @retval  Pointer to the arena or NULL if there is no memory for it.
+ */
+SimpleArena * simple_arena_create(void);
+
+
+/**
+ * @name    simple_arena_alloc
+ * @brief   Allocate size bytes from the arena.
+ * @retval  Pointer to the memory (8-byte aligned) or NULL if no chunk could be allocated.
+ */
+void * simple_arena_alloc(SimpleArena * arena, size_t size);
+
+
+/**
+ * @name    simple_arena_save
+ * @brief   Remember the current position of the arena. Marks nest like a stack.
+ */
+SimpleArenaMark simple_arena_save(SimpleArena * arena);
+
+
+/**
+ * @name    simple_arena_restore
+ * @brief   Free everything allocated since `mark` was saved.
+ *
+ * Marks saved after `mark` become invalid, as do all marks after a reset.
+ */
+void simple_arena_restore(SimpleArena * arena, SimpleArenaMark mark);
+
+
+/**
+ * @name    simple_arena_reset
+ * @brief   Free everything allocated from the arena in O(1). Its chunks are kept for reuse.
+ */
+void simple_arena_reset(SimpleArena * arena);
+
+
+/**
+ * @name    simple_arena_destroy
+ * @brief   Return every chunk of the arena to the heap and free the arena itself.
+ */
+void simple_arena_destroy(SimpleArena * arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MM_ARENA_H_ */
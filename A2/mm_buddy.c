@@ -0,0 +1,605 @@
+/**
+ * @file   mm_buddy.c
+ * @brief  Binary buddy allocator behind the mm.h API, an alternative to mm.c.
+ *
+ * Built instead of mm.c with make MM_FLAGS=-DMM_BUDDY. The managed region is
+ * tiled with blocks whose sizes are powers of two, each aligned to its size
+ * relative to the start of the region. A request takes the smallest free
+ * block of at least its size plus header, halving larger blocks as needed.
+ * A freed block merges with its buddy, found by flipping one bit of its
+ * offset, for as long as the buddy is free and of the same order.
+ *
+ * Both directions touch at most one block per order, so malloc and free are
+ * O(log n) in the size of the region with no list walks, at the price of
+ * rounding every request up to a power of two.
+ */
+
+#define _GNU_SOURCE  // mremap
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mm.h"
+
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef MM_HANDLES
+#error "Handles and compaction need the block list of mm.c"
+#endif
+
+#ifdef MM_RELEASE
+#error "Releasing free pages needs the block list of mm.c"
+#endif
+
+#ifdef MM_SHARED
+#error "The shared heap needs the block list of mm.c"
+#endif
+
+#ifdef MM_GROWABLE
+#error "The buddy allocator manages the fixed region only"
+#endif
+
+#if defined(MM_SEGLIST) || defined(MM_TREE) || defined(MM_CLASSES) || defined(MM_QUICKLISTS) || defined(MM_SLABS)
+#error "The buddy allocator has free lists of its own; size classes, trees, quick lists and slabs belong to mm.c"
+#endif
+
+#if defined(MM_PROFILE) || defined(MM_HUGEPAGES)
+#error "Profiling and huge pages are only implemented in mm.c"
+#endif
+
+typedef struct header {
+    uintptr_t tag;            // Order and flags of a heap block, see the masks below
+    uint64_t user_block[0];   // Empty array to ensure alignment of user block
+} BlockHeader;
+
+#define FREE_MASK      0x1 // Block is on a free list
+#define ALIGNED_MASK   0x2 // Word in front of a simple_memalign pointer, holds the distance back to the header
+#define MMAPPED_MASK   0x4 // Block is a mapping of its own, holds the length of the mapping
+#define FLAG_MASK      0x7
+#define ORDER_SHIFT    3
+#define GET_ORDER(p) ((unsigned)((p)->tag >> ORDER_SHIFT)) // Block spans 2^order bytes including the header
+#define GET_FREE(p) ((p)->tag & FREE_MASK)
+#define TAG_VALUE(w) ((uintptr_t)(w) & ~FLAG_MASK) // Length or distance stored in a flagged word
+#define BLOCK_SIZE(order) ((size_t)1 << (order))
+
+typedef struct free_links {
+    BlockHeader *next_free;
+    BlockHeader *prev_free;
+} FreeLinks;
+
+#define LINKS(p) ((FreeLinks *)(p)->user_block) // Free list links of a free block
+#define MIN_ORDER 5   // 32 bytes, room for the header and the links
+#define NUM_ORDERS 64
+
+static BlockHeader *free_lists[NUM_ORDERS];  // Free blocks of each order
+static uint64_t free_map = 0;                // Bit set for each non-empty order
+
+static uintptr_t heap_base = 0;   // Offsets, and so buddies, are relative to this address
+static size_t heap_size = 0;      // Bytes of the region covered by blocks
+
+static uint64_t search_histogram[MM_SEARCH_BUCKETS];
+static uint64_t split_count = 0;
+static uint64_t coalesce_count = 0;
+
+#ifndef MM_MMAP_THRESHOLD
+#define MM_MMAP_THRESHOLD 0         // Requests of at least this size get their own mapping, 0 disables
+#endif
+
+static size_t mmap_threshold = MM_MMAP_THRESHOLD;
+static uint64_t mmapped_blocks = 0;
+static uint64_t mmapped_bytes = 0;
+
+#ifdef MM_THREADS
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;  // Protects every block and the free lists
+#define HEAP_LOCK()   pthread_mutex_lock(&heap_lock)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&heap_lock)
+#else
+#define HEAP_LOCK()   ((void)0)
+#define HEAP_UNLOCK() ((void)0)
+#endif
+
+/**
+ * @name    list_push
+ * @brief   Mark a block free with the given order and put it on the free list of that order.
+ */
+static void list_push(BlockHeader *block, unsigned order) {
+    block->tag = ((uintptr_t)order << ORDER_SHIFT) | FREE_MASK;
+    LINKS(block)->next_free = free_lists[order];
+    LINKS(block)->prev_free = NULL;
+    if (free_lists[order] != NULL) LINKS(free_lists[order])->prev_free = block;
+    free_lists[order] = block;
+    free_map |= 1ull << order;
+}
+
+/**
+ * @name    list_remove
+ * @brief   Unlink a free block from the free list of its order.
+ */
+static void list_remove(BlockHeader *block) {
+    unsigned order = GET_ORDER(block);
+    BlockHeader *next = LINKS(block)->next_free;
+    BlockHeader *prev = LINKS(block)->prev_free;
+    if (next != NULL) LINKS(next)->prev_free = prev;
+    if (prev != NULL) {
+        LINKS(prev)->next_free = next;
+    } else {
+        free_lists[order] = next;
+        if (next == NULL) free_map &= ~(1ull << order);
+    }
+}
+
+/**
+ * @name    simple_init
+ * @brief   Tile the managed region with the largest aligned blocks that fit.
+ */
+void simple_init() {
+    if (heap_base != 0) return;
+    heap_base = (memory_start + 7) & ~7;  // Align to 8-byte boundary
+    uintptr_t end = memory_end & ~7;      // Align to 8-byte boundary
+
+    size_t offset = 0;
+    while (end - heap_base - offset >= BLOCK_SIZE(MIN_ORDER)) {
+        // Largest order that is aligned at this offset and still fits
+        unsigned order = 63 - __builtin_clzll(end - heap_base - offset);
+        if (offset != 0 && (unsigned)__builtin_ctzll(offset) < order) order = __builtin_ctzll(offset);
+        list_push((BlockHeader *)(heap_base + offset), order);
+        offset += BLOCK_SIZE(order);
+    }
+    heap_size = offset;
+}
+
+/**
+ * @name    order_for
+ * @brief   Smallest order whose blocks hold `size` bytes after the header, or NUM_ORDERS if none can.
+ */
+static unsigned order_for(size_t size) {
+    if (size > BLOCK_SIZE(NUM_ORDERS - 2)) return NUM_ORDERS;
+    size_t total = size + sizeof(BlockHeader);
+    unsigned order = (total <= 1) ? 0 : 64 - __builtin_clzll(total - 1);
+    return order < MIN_ORDER ? MIN_ORDER : order;
+}
+
+/**
+ * @name    record_search
+ * @brief   Count a search that examined `visited` free lists in its power-of-two histogram bucket.
+ */
+static void record_search(uint64_t visited) {
+    unsigned bucket = (visited == 0) ? 0 : 64 - __builtin_clzll(visited);
+    if (bucket >= MM_SEARCH_BUCKETS) bucket = MM_SEARCH_BUCKETS - 1;
+    search_histogram[bucket]++;
+}
+
+/**
+ * @name    heap_malloc
+ * @brief   Take a block of exactly `order` from the free lists, halving a larger one if needed. Caller holds the heap lock.
+ * @retval  The allocated block or NULL if no free block is large enough.
+ */
+static BlockHeader *heap_malloc(unsigned order) {
+    if (heap_base == 0) simple_init();
+    if (order >= NUM_ORDERS) return NULL;
+
+    // The bitmap finds the smallest non-empty order without looking at any list
+    uint64_t candidates = free_map & (~0ull << order);
+    record_search(candidates != 0);
+    if (candidates == 0) return NULL;
+    unsigned found = __builtin_ctzll(candidates);
+
+    BlockHeader *block = free_lists[found];
+    list_remove(block);
+
+    // Keep the lower half and free the upper half until the block has the wanted order
+    while (found > order) {
+        found--;
+        list_push((BlockHeader *)((uintptr_t)block + BLOCK_SIZE(found)), found);
+        split_count++;
+    }
+    block->tag = (uintptr_t)order << ORDER_SHIFT;
+    return block;
+}
+
+/**
+ * @name    buddy_of
+ * @brief   The buddy of a block of `order` at `block`, or NULL if it lies past the end of the region.
+ */
+static BlockHeader *buddy_of(BlockHeader *block, unsigned order) {
+    size_t offset = ((uintptr_t)block - heap_base) ^ BLOCK_SIZE(order);
+    if (offset + BLOCK_SIZE(order) > heap_size) return NULL;
+    return (BlockHeader *)(heap_base + offset);
+}
+
+/**
+ * @name    heap_free
+ * @brief   Return a block to the free lists, merging it with free buddies. Caller holds the heap lock.
+ */
+static void heap_free(BlockHeader *block) {
+    if (GET_FREE(block)) {
+        printf("Warning: Attempting to free an already free block at address %p.\n", (void *)block->user_block);
+        return;
+    }
+
+    unsigned order = GET_ORDER(block);
+    for (;;) {
+        BlockHeader *buddy = buddy_of(block, order);
+        if (buddy == NULL || !GET_FREE(buddy) || GET_ORDER(buddy) != order) break;
+        list_remove(buddy);
+        if (buddy < block) block = buddy;
+        order++;
+        coalesce_count++;
+    }
+    list_push(block, order);
+}
+
+/**
+ * @name    heap_resize
+ * @brief   Resize an allocated block in place to `order`. Caller holds the heap lock.
+ * @retval  1 if the block now has that order, 0 if it has to move.
+ *
+ * Shrinking frees upper halves. Growing absorbs upper buddies, which is only
+ * possible while the block is the lower buddy at every order on the way.
+ */
+static int heap_resize(BlockHeader *block, unsigned order) {
+    unsigned current = GET_ORDER(block);
+    if (order >= NUM_ORDERS) return 0;
+
+    for (unsigned o = current; o < order; o++) {
+        BlockHeader *buddy = buddy_of(block, o);
+        if (buddy == NULL || buddy < block || !GET_FREE(buddy) || GET_ORDER(buddy) != o) return 0;
+    }
+    for (unsigned o = current; o < order; o++) {
+        list_remove(buddy_of(block, o));
+        coalesce_count++;
+    }
+    while (current > order) {
+        current--;
+        BlockHeader *upper = (BlockHeader *)((uintptr_t)block + BLOCK_SIZE(current));
+        upper->tag = (uintptr_t)current << ORDER_SHIFT;
+        heap_free(upper);  // Merges with a free buddy of its own
+        split_count++;
+    }
+    block->tag = (uintptr_t)order << ORDER_SHIFT;
+    return 1;
+}
+
+/**
+ * @name    page_round
+ * @brief   Round a length up to a whole number of pages.
+ */
+static size_t page_round(size_t length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (length + page - 1) & ~(page - 1);
+}
+
+/**
+ * @name    mmap_alloc
+ * @brief   Serve a large request from a mapping of its own, outside the buddy region.
+ * @retval  Pointer to the user block (zero-filled) or NULL if the kernel refused.
+ */
+static void *mmap_alloc(size_t size) {
+    size_t length = page_round(size + sizeof(BlockHeader));
+    if (length < size) return NULL;  // Overflow
+
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+
+    BlockHeader *block = base;
+    block->tag = length | MMAPPED_MASK;
+    __atomic_fetch_add(&mmapped_blocks, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mmapped_bytes, length, __ATOMIC_RELAXED);
+    return (void *)(block->user_block);
+}
+
+/**
+ * @name    mmap_free
+ * @brief   Return a mapped block to the kernel right away.
+ */
+static void mmap_free(BlockHeader *block) {
+    size_t length = TAG_VALUE(block->tag);
+    __atomic_fetch_sub(&mmapped_blocks, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&mmapped_bytes, length, __ATOMIC_RELAXED);
+    munmap(block, length);
+}
+
+/**
+ * @name    mmap_realloc
+ * @brief   Resize a mapped block with mremap.
+ * @retval  Pointer to the user block or NULL if the kernel refused, in which case the block is untouched.
+ */
+static void *mmap_realloc(BlockHeader *block, size_t size) {
+    size_t old_length = TAG_VALUE(block->tag);
+    size_t length = page_round(size + sizeof(BlockHeader));
+    if (length == old_length) return (void *)(block->user_block);
+
+    BlockHeader *moved = mremap(block, old_length, length, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) return NULL;
+
+    moved->tag = length | MMAPPED_MASK;
+    __atomic_fetch_add(&mmapped_bytes, length - old_length, __ATOMIC_RELAXED);
+    return (void *)(moved->user_block);
+}
+
+/**
+ * @name    simple_set_mmap_threshold
+ * @brief   Serve requests of at least `threshold` bytes from dedicated mappings; 0 disables this.
+ * @retval  The previous threshold.
+ */
+size_t simple_set_mmap_threshold(size_t threshold) {
+    return __atomic_exchange_n(&mmap_threshold, threshold, __ATOMIC_RELAXED);
+}
+
+/**
+ * @name    large_request
+ * @brief   Whether a request bypasses the buddy region for a mapping of its own.
+ */
+static int large_request(size_t size) {
+    size_t threshold = __atomic_load_n(&mmap_threshold, __ATOMIC_RELAXED);
+    return threshold != 0 && size >= threshold;
+}
+
+/**
+ * @name    header_of
+ * @brief   Header of the block a user pointer belongs to, looking through the word in front of aligned pointers.
+ */
+static BlockHeader *header_of(void *ptr) {
+    BlockHeader *block = (BlockHeader *)((uintptr_t)ptr - sizeof(BlockHeader));
+    uintptr_t tag = __atomic_load_n(&block->tag, __ATOMIC_RELAXED);
+    if ((tag & FLAG_MASK) == ALIGNED_MASK) block = (BlockHeader *)((uintptr_t)block - TAG_VALUE(tag));
+    return block;
+}
+
+/**
+ * @name    simple_malloc
+ * @brief   Allocate at least `size` contiguous bytes of memory and return a pointer to the first byte.
+ * @param   size_t size Number of bytes to allocate.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ */
+void *simple_malloc(size_t size) {
+    if (large_request(size)) return mmap_alloc(size);
+
+    HEAP_LOCK();
+    BlockHeader *block = heap_malloc(order_for(size));
+    HEAP_UNLOCK();
+    return block != NULL ? (void *)(block->user_block) : NULL;
+}
+
+/**
+ * @name    simple_free
+ * @brief   Frees previously allocated memory and makes it available for subsequent calls to simple_malloc
+ * @param   void *ptr Pointer to the memory to free.
+ */
+void simple_free(void *ptr) {
+    if (ptr == NULL) return;
+
+    BlockHeader *block = header_of(ptr);
+    if (__atomic_load_n(&block->tag, __ATOMIC_RELAXED) & MMAPPED_MASK) {
+        mmap_free(block);
+        return;
+    }
+
+    HEAP_LOCK();
+    heap_free(block);
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_realloc
+ * @brief   Resize previously allocated memory, keeping its contents up to the smaller of the two sizes.
+ * @param   void *ptr Pointer to the memory to resize, or NULL to allocate.
+ * @param   size_t size New size in bytes, or 0 to free.
+ * @retval  Pointer to the resized memory or NULL if not possible, in which case ptr is untouched.
+ */
+void *simple_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) return simple_malloc(size);
+    if (size == 0) {
+        simple_free(ptr);
+        return NULL;
+    }
+
+    // Aligned pointers keep their place only if the new size fits in what is left of the block
+    BlockHeader *block = header_of(ptr);
+    size_t offset = (uintptr_t)ptr - (uintptr_t)block->user_block;
+    size_t old_size;
+    if (block->tag & MMAPPED_MASK) {
+        if (offset == 0) return mmap_realloc(block, size);
+        old_size = TAG_VALUE(block->tag) - sizeof(BlockHeader) - offset;
+    } else {
+        HEAP_LOCK();
+        int resized = (offset == 0) && heap_resize(block, order_for(size));
+        old_size = BLOCK_SIZE(GET_ORDER(block)) - sizeof(BlockHeader) - offset;
+        HEAP_UNLOCK();
+        if (resized) return ptr;
+    }
+    if (offset != 0 && size <= old_size) return ptr;
+
+    // Move the contents to a new block
+    void *new_ptr = simple_malloc(size);
+    if (new_ptr == NULL) return NULL;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    simple_free(ptr);
+    return new_ptr;
+}
+
+/**
+ * @name    simple_memalign
+ * @brief   Allocate at least `size` bytes at an address that is a multiple of `alignment`.
+ * @param   size_t alignment A power of two.
+ * @param   size_t size Number of bytes to allocate.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ *
+ * Buddy blocks are aligned to their size but the header pushes the user block
+ * off that alignment, so the block is padded by the alignment and the word in
+ * front of the returned pointer leads back to the header.
+ */
+void *simple_memalign(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) return NULL;
+    if (alignment <= 8) return simple_malloc(size);  // Every block is 8-byte aligned
+    if (size + alignment < size) return NULL;        // Overflow
+
+    uint8_t *ptr = simple_malloc(size + alignment);
+    if (ptr == NULL) return NULL;
+    uintptr_t user = ((uintptr_t)ptr + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (user != (uintptr_t)ptr) {
+        // There are at least 8 bytes in front of user, and the tag of the block stays intact
+        BlockHeader *word = (BlockHeader *)(user - sizeof(BlockHeader));
+        word->tag = ((uintptr_t)word - ((uintptr_t)ptr - sizeof(BlockHeader))) | ALIGNED_MASK;
+    }
+    return (void *)user;
+}
+
+/**
+ * @name    simple_usable_size
+ * @brief   Bytes that may be used at `ptr`, up to the end of its block or mapping.
+ * @retval  The usable size, 0 for NULL.
+ */
+size_t simple_usable_size(void *ptr) {
+    if (ptr == NULL) return 0;
+    BlockHeader *block = header_of(ptr);
+    size_t offset = (uintptr_t)ptr - (uintptr_t)block->user_block;
+    if (block->tag & MMAPPED_MASK) return TAG_VALUE(block->tag) - sizeof(BlockHeader) - offset;
+
+    HEAP_LOCK();
+    size_t size = BLOCK_SIZE(GET_ORDER(block)) - sizeof(BlockHeader) - offset;
+    HEAP_UNLOCK();
+    return size;
+}
+
+/**
+ * @name    simple_calloc
+ * @brief   Allocate zero-filled memory for an array of `nmemb` elements of `size` bytes.
+ * @retval  Pointer to the start of the allocated memory or NULL if not possible.
+ */
+void *simple_calloc(size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > SIZE_MAX / size) return NULL;  // Overflow
+    size_t total = nmemb * size;
+    if (large_request(total)) return mmap_alloc(total);  // Fresh mappings are zero
+
+    void *ptr = simple_malloc(total);
+    if (ptr != NULL) memset(ptr, 0, total);
+    return ptr;
+}
+
+/**
+ * @name    simple_malloc_batch
+ * @brief   Allocate `n` blocks of at least `size` bytes each, storing them in `out`.
+ * @retval  Number of blocks allocated; the first that many entries of `out` are set.
+ */
+size_t simple_malloc_batch(size_t size, size_t n, void *out[]) {
+    size_t done = 0;
+    if (large_request(size)) {
+        while (done < n && (out[done] = mmap_alloc(size)) != NULL) done++;
+        return done;
+    }
+
+    unsigned order = order_for(size);
+    HEAP_LOCK();
+    for (; done < n; done++) {
+        BlockHeader *block = heap_malloc(order);
+        if (block == NULL) break;
+        out[done] = (void *)(block->user_block);
+    }
+    HEAP_UNLOCK();
+    return done;
+}
+
+/**
+ * @name    simple_free_batch
+ * @brief   Free the `n` blocks in `ptrs` under one lock acquisition. NULL entries are skipped.
+ *
+ * Buddies merge without looking at neighbours, so unlike mm.c the batch needs no sorting.
+ */
+void simple_free_batch(void *ptrs[], size_t n) {
+    HEAP_LOCK();
+    for (size_t i = 0; i < n; i++) {
+        if (ptrs[i] == NULL) continue;
+        BlockHeader *block = header_of(ptrs[i]);
+        if (block->tag & MMAPPED_MASK) {
+            mmap_free(block);
+        } else {
+            heap_free(block);
+        }
+    }
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_mm_stats
+ * @brief   Fill `stats` with a snapshot of the heap.
+ *
+ * The blocks tile the region, so the walk steps from each block to the next by its size.
+ */
+void simple_mm_stats(SimpleStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    HEAP_LOCK();
+    for (size_t offset = 0; offset < heap_size;) {
+        BlockHeader *block = (BlockHeader *)(heap_base + offset);
+        size_t size = BLOCK_SIZE(GET_ORDER(block)) - sizeof(BlockHeader);
+        if (GET_FREE(block)) {
+            stats->bytes_free += size;
+            stats->blocks_free++;
+            if (size > stats->largest_free) stats->largest_free = size;
+        } else {
+            stats->bytes_in_use += size;
+            stats->blocks_in_use++;
+        }
+        offset += size + sizeof(BlockHeader);
+    }
+    memcpy(stats->search_histogram, search_histogram, sizeof(search_histogram));
+    stats->splits = split_count;
+    stats->coalesces = coalesce_count;
+    HEAP_UNLOCK();
+
+    stats->mmapped_blocks = __atomic_load_n(&mmapped_blocks, __ATOMIC_RELAXED);
+    stats->mmapped_bytes = __atomic_load_n(&mmapped_bytes, __ATOMIC_RELAXED);
+
+    if (stats->bytes_free > 0) {
+        stats->fragmentation = 1.0 - (double)stats->largest_free / (double)stats->bytes_free;
+    }
+}
+
+/**
+ * @name    simple_mm_profile_write
+ * @brief   Size profiling is only implemented by mm.c.
+ * @retval  -1
+ */
+int simple_mm_profile_write(const char *path) {
+    (void)path;
+    return -1;
+}
+
+/**
+ * @name    simple_set_fit
+ * @brief   Placement policies do not apply to buddies: every request takes the smallest free order.
+ */
+void simple_set_fit(SimpleFit fit) {
+}
+
+#ifdef MM_THREADS
+/**
+ * @name    simple_fork_prepare
+ * @brief   Take the heap lock, so no other thread holds it while the process forks.
+ */
+void simple_fork_prepare(void) {
+    HEAP_LOCK();
+}
+
+/**
+ * @name    simple_fork_parent
+ * @brief   Release the heap lock in the parent.
+ */
+void simple_fork_parent(void) {
+    HEAP_UNLOCK();
+}
+
+/**
+ * @name    simple_fork_child
+ * @brief   Reset the heap lock in the child, where only the forking thread exists.
+ */
+void simple_fork_child(void) {
+    pthread_mutex_init(&heap_lock, NULL);
+}
+#endif
@@ -0,0 +1,182 @@
+/**
+ * @file   mm_classes.h
+ * @brief  Size classes for MM_SEGLIST with MM_CLASSES, generated by size_classes. Do not edit.
+ *
+ * Profiled from 478328 requests in profile.txt.
+ */
+
+#ifndef MM_CLASSES_H_
+#define MM_CLASSES_H_
+
+#define CLASS_EXACT 4096  // Sizes up to here are looked up in class_small
+
+/* Class of each size up to CLASS_EXACT, indexed by size / 8 */
+static const uint8_t class_small[CLASS_EXACT / 8 + 1] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+    48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63,
+    64, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    66, 66, 66, 66, 66, 66, 67, 68, 69, 69, 69, 69, 69, 69, 69, 70,
+    71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 72, 73, 73, 73, 73,
+    73, 74, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75,
+    75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75,
+    75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 76, 77, 77, 77,
+    77, 77, 77, 77, 78, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79,
+    79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79,
+    79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 80,
+    81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81,
+    81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81,
+    81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81,
+    81, 81, 81, 82, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83,
+    84, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85,
+    85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85,
+    85, 85, 85, 86, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87,
+    87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 88, 89, 89, 89, 89,
+    89, 90, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91,
+    91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91,
+    92
+};
+
+/* Smallest size of each class */
+static const uint64_t class_limits[128] = {
+    0ull,
+    8ull,  // 5352 requests, 5352 frees, mean lifetime 1644.9
+    16ull,  // 139880 requests, 139880 frees, mean lifetime 2814.8
+    24ull,  // 21944 requests, 21944 frees, mean lifetime 2428.4
+    32ull,  // 21288 requests, 21288 frees, mean lifetime 2499.3
+    40ull,  // 21176 requests, 21176 frees, mean lifetime 2500.7
+    48ull,  // 21072 requests, 21072 frees, mean lifetime 2511.6
+    56ull,  // 12168 requests, 12168 frees, mean lifetime 3302.7
+    64ull,  // 12160 requests, 12160 frees, mean lifetime 3214.4
+    72ull,  // 448 requests, 448 frees, mean lifetime 778.3
+    80ull,  // 432 requests, 432 frees, mean lifetime 1148.6
+    88ull,  // 424 requests, 424 frees, mean lifetime 816.3
+    96ull,  // 288 requests, 288 frees, mean lifetime 877.3
+    104ull,  // 392 requests, 392 frees, mean lifetime 1106.1
+    112ull,  // 344 requests, 344 frees, mean lifetime 1044.6
+    120ull,  // 400 requests, 400 frees, mean lifetime 1202.5
+    128ull,  // 392 requests, 392 frees, mean lifetime 970.6
+    136ull,  // 408 requests, 408 frees, mean lifetime 863.0
+    144ull,  // 392 requests, 392 frees, mean lifetime 1253.8
+    152ull,  // 440 requests, 440 frees, mean lifetime 1230.9
+    160ull,  // 424 requests, 424 frees, mean lifetime 953.8
+    168ull,  // 320 requests, 320 frees, mean lifetime 1179.3
+    176ull,  // 400 requests, 400 frees, mean lifetime 1170.0
+    184ull,  // 424 requests, 424 frees, mean lifetime 811.0
+    192ull,  // 392 requests, 392 frees, mean lifetime 1516.9
+    200ull,  // 360 requests, 360 frees, mean lifetime 953.3
+    208ull,  // 360 requests, 360 frees, mean lifetime 697.4
+    216ull,  // 448 requests, 448 frees, mean lifetime 994.4
+    224ull,  // 448 requests, 448 frees, mean lifetime 1013.2
+    232ull,  // 400 requests, 400 frees, mean lifetime 1112.2
+    240ull,  // 352 requests, 352 frees, mean lifetime 991.8
+    248ull,  // 400 requests, 400 frees, mean lifetime 910.0
+    256ull,  // 376 requests, 376 frees, mean lifetime 1238.6
+    264ull,  // 408 requests, 408 frees, mean lifetime 890.3
+    272ull,  // 456 requests, 456 frees, mean lifetime 1050.8
+    280ull,  // 336 requests, 336 frees, mean lifetime 777.4
+    288ull,  // 424 requests, 424 frees, mean lifetime 1080.5
+    296ull,  // 464 requests, 464 frees, mean lifetime 1051.4
+    304ull,  // 408 requests, 408 frees, mean lifetime 951.2
+    312ull,  // 448 requests, 448 frees, mean lifetime 932.9
+    320ull,  // 392 requests, 392 frees, mean lifetime 1242.7
+    328ull,  // 408 requests, 408 frees, mean lifetime 1286.1
+    336ull,  // 400 requests, 400 frees, mean lifetime 797.9
+    344ull,  // 304 requests, 304 frees, mean lifetime 915.3
+    352ull,  // 456 requests, 456 frees, mean lifetime 871.7
+    360ull,  // 424 requests, 424 frees, mean lifetime 769.7
+    368ull,  // 336 requests, 336 frees, mean lifetime 883.6
+    376ull,  // 448 requests, 448 frees, mean lifetime 1308.8
+    384ull,  // 376 requests, 376 frees, mean lifetime 1041.7
+    392ull,  // 424 requests, 424 frees, mean lifetime 722.4
+    400ull,  // 480 requests, 480 frees, mean lifetime 856.6
+    408ull,  // 376 requests, 376 frees, mean lifetime 1113.9
+    416ull,  // 352 requests, 352 frees, mean lifetime 1142.8
+    424ull,  // 440 requests, 440 frees, mean lifetime 1070.7
+    432ull,  // 408 requests, 408 frees, mean lifetime 781.5
+    440ull,  // 432 requests, 432 frees, mean lifetime 921.1
+    448ull,  // 376 requests, 376 frees, mean lifetime 940.9
+    456ull,  // 416 requests, 416 frees, mean lifetime 789.9
+    464ull,  // 392 requests, 392 frees, mean lifetime 939.8
+    472ull,  // 480 requests, 480 frees, mean lifetime 1110.1
+    480ull,  // 424 requests, 424 frees, mean lifetime 990.5
+    488ull,  // 312 requests, 312 frees, mean lifetime 783.9
+    496ull,  // 312 requests, 312 frees, mean lifetime 624.1
+    504ull,  // 352 requests, 352 frees, mean lifetime 967.0
+    512ull,  // 448 requests, 448 frees, mean lifetime 1049.7
+    520ull,
+    1024ull,
+    1072ull,  // 144 requests, 144 frees, mean lifetime 560.9
+    1080ull,  // 144 requests, 144 frees, mean lifetime 846.7
+    1088ull,
+    1144ull,  // 136 requests, 136 frees, mean lifetime 734.4
+    1152ull,
+    1240ull,  // 144 requests, 144 frees, mean lifetime 719.4
+    1248ull,
+    1288ull,  // 144 requests, 144 frees, mean lifetime 689.0
+    1296ull,
+    1632ull,  // 136 requests, 136 frees, mean lifetime 676.2
+    1640ull,
+    1696ull,  // 152 requests, 152 frees, mean lifetime 497.9
+    1704ull,
+    2040ull,  // 160 requests, 160 frees, mean lifetime 519.5
+    2048ull,
+    2456ull,  // 136 requests, 136 frees, mean lifetime 694.8
+    2464ull,
+    3328ull,  // 136 requests, 136 frees, mean lifetime 1156.2
+    3336ull,
+    3608ull,  // 152 requests, 152 frees, mean lifetime 797.9
+    3616ull,
+    3800ull,  // 144 requests, 144 frees, mean lifetime 419.9
+    3808ull,
+    3848ull,  // 160 requests, 160 frees, mean lifetime 620.6
+    3856ull,
+    4096ull,
+    8192ull,
+    16384ull,
+    32768ull,
+    65536ull,
+    131072ull,
+    262144ull,
+    524288ull,
+    1048576ull,
+    2097152ull,
+    4194304ull,
+    8388608ull,
+    16777216ull,
+    33554432ull,
+    67108864ull,
+    134217728ull,
+    268435456ull,
+    536870912ull,
+    1073741824ull,
+    2147483648ull,
+    4294967296ull,
+    8589934592ull,
+    17179869184ull,
+    34359738368ull,
+    68719476736ull,
+    137438953472ull,
+    274877906944ull,
+    549755813888ull,
+    1099511627776ull,
+    2199023255552ull,
+    4398046511104ull,
+    8796093022208ull,
+    17592186044416ull,
+    35184372088832ull,
+    70368744177664ull,
+    140737488355328ull,
+};
+
+#endif /* MM_CLASSES_H_ */
@@ -0,0 +1,145 @@
+/**
+ * @file   mm_pool.c
+ * @brief  Fixed-size object pools carved out of the managed memory.
+ */
+
+#include <stdint.h>
+#include "mm.h"
+#include "mm_pool.h"
+
+#define POOL_SLAB_SIZE       (64 * 1024)  // Bytes requested from simple_malloc per slab
+#define POOL_ARENA_SLAB_SIZE (4 * 1024)   // Bytes per slab from an arena, so several fit in one of its chunks
+
+/* Free slots are linked through their first word */
+typedef struct slot {
+    struct slot *next;
+} Slot;
+
+/* Each slab starts with a link to the previously allocated slab */
+typedef struct slab {
+    struct slab *next;
+    uint64_t slots[0];        // Empty array to ensure alignment of the first slot
+} Slab;
+
+struct simple_pool {
+    size_t slot_size;         // Object size rounded up to a multiple of 8
+    Slot *free_slots;         // Stack of freed slots
+    uintptr_t bump;           // Next never-used slot in the newest slab
+    uintptr_t bump_end;       // End of the newest slab
+    Slab *slabs;              // All slabs, newest first
+    SimpleArena *arena;       // Where the slabs come from, NULL for simple_malloc
+};
+
+/**
+ * @name    simple_pool_create
+ * @brief   Create a pool for objects of object_size bytes.
+ * @retval  Pointer to the pool or NULL if there is no memory for it.
+ */
+SimplePool *simple_pool_create(size_t object_size) {
+    return simple_pool_create_in(NULL, object_size);
+}
+
+/**
+ * @name    simple_pool_create_in
+ * @brief   Create a pool for objects of object_size bytes with slabs from `arena`, or simple_malloc if NULL.
+ * @retval  Pointer to the pool or NULL if there is no memory for it.
+ */
+SimplePool *simple_pool_create_in(SimpleArena *arena, size_t object_size) {
+    SimplePool *pool = simple_malloc(sizeof(SimplePool));
+    if (pool == NULL) return NULL;
+
+    // Every slot must be able to hold the free-stack link
+    size_t slot_size = (object_size + 7) & ~7;
+    if (slot_size < sizeof(Slot)) slot_size = sizeof(Slot);
+
+    pool->slot_size = slot_size;
+    pool->free_slots = NULL;
+    pool->bump = 0;
+    pool->bump_end = 0;
+    pool->slabs = NULL;
+    pool->arena = arena;
+    return pool;
+}
+
+/**
+ * @name    pool_grow
+ * @brief   Add a slab to the pool. Its slots are handed out lazily by simple_pool_alloc.
+ * @retval  0 on success, -1 if no memory was left for it.
+ */
+static int pool_grow(SimplePool *pool) {
+    size_t slab_size = (pool->arena != NULL) ? POOL_ARENA_SLAB_SIZE : POOL_SLAB_SIZE;
+    if (slab_size < sizeof(Slab) + pool->slot_size) slab_size = sizeof(Slab) + pool->slot_size;
+
+    Slab *slab = (pool->arena != NULL) ? simple_arena_alloc(pool->arena, slab_size) : simple_malloc(slab_size);
+    if (slab == NULL) return -1;
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->bump = (uintptr_t)slab->slots;
+    pool->bump_end = (uintptr_t)slab + slab_size;
+    return 0;
+}
+
+/**
+ * @name    simple_pool_alloc
+ * @brief   Allocate one object from the pool.
+ * @retval  Pointer to the object (8-byte aligned) or NULL if no slab could be allocated.
+ */
+void *simple_pool_alloc(SimplePool *pool) {
+    // Reuse the most recently freed slot first
+    Slot *slot = pool->free_slots;
+    if (slot != NULL) {
+        pool->free_slots = slot->next;
+        return slot;
+    }
+
+    // Otherwise carve the next slot of the newest slab
+    if (pool->bump + pool->slot_size > pool->bump_end) {
+        if (pool_grow(pool) != 0) return NULL;
+    }
+    void *ptr = (void *)pool->bump;
+    pool->bump += pool->slot_size;
+    return ptr;
+}
+
+/**
+ * @name    simple_pool_free
+ * @brief   Return an object previously allocated from the same pool.
+ */
+void simple_pool_free(SimplePool *pool, void *ptr) {
+    if (ptr == NULL) return;
+
+    Slot *slot = ptr;
+    slot->next = pool->free_slots;
+    pool->free_slots = slot;
+}
+
+/**
+ * @name    simple_pool_reset
+ * @brief   Drop every object and slab of the pool. Slabs from simple_malloc are freed, those from an arena left to it.
+ */
+void simple_pool_reset(SimplePool *pool) {
+    if (pool->arena == NULL) {
+        Slab *slab = pool->slabs;
+        while (slab != NULL) {
+            Slab *next = slab->next;
+            simple_free(slab);
+            slab = next;
+        }
+    }
+    pool->free_slots = NULL;
+    pool->bump = 0;
+    pool->bump_end = 0;
+    pool->slabs = NULL;
+}
+
+/**
+ * @name    simple_pool_destroy
+ * @brief   Free every slab of the pool and the pool itself, including all live objects.
+ */
+void simple_pool_destroy(SimplePool *pool) {
+    if (pool == NULL) return;
+
+    simple_pool_reset(pool);
+    simple_free(pool);
+}
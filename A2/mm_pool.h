@@ -0,0 +1,78 @@
+/**
+ * @file   mm_pool.h
+ * @brief  Fixed-size object pools on top of the memory management subsystem.
+ *
+ * A pool hands out objects of one size from slabs obtained with
+ * simple_malloc. Objects carry no header, and allocation and free are O(1)
+ * through a stack of free slots. A pool must only be used by one thread at a time.
+ *
+ * A pool created with simple_pool_create_in takes its slabs from an arena
+ * instead, so the arena frees them all at once; simple_pool_reset then makes
+ * the pool forget them.
+ */
+
+#ifndef MM_POOL_H_
+#define MM_POOL_H_
+
+#include <stddef.h>
+#include "mm_arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct simple_pool SimplePool;
+
+
+/**
+ * @name    simple_pool_create
+ * @brief   Create a pool for objects of object_size bytes.
+ * @retval  Pointer to the pool or NULL if there is no memory for it.
+ */
+SimplePool * simple_pool_create(size_t object_size);
+
+
+/**
+ * @name    simple_pool_create_in
+ * @brief   Create a pool for objects of object_size bytes whose slabs come from arena, or from
+ *          simple_malloc if arena is NULL. The pool itself is allocated with simple_malloc.
+ * @retval  Pointer to the pool or NULL if there is no memory for it.
+ */
+SimplePool * simple_pool_create_in(SimpleArena * arena, size_t object_size);
+
+
+/**
+ * @name    simple_pool_alloc
+ * @brief   Allocate one object from the pool.
+ * @retval  Pointer to the object (8-byte aligned) or NULL if no slab could be allocated.
+ */
+void * simple_pool_alloc(SimplePool * pool);
+
+
+/**
+ * @name    simple_pool_free
+ * @brief   Return an object previously allocated from the same pool.
+ */
+void simple_pool_free(SimplePool * pool, void * ptr);
+
+
+/**
+ * @name    simple_pool_reset
+ * @brief   Drop every object and slab of the pool, which stays usable. Slabs from simple_malloc are
+ *          freed; slabs from an arena are left to it, so reset the pool whenever the arena is reset.
+ */
+void simple_pool_reset(SimplePool * pool);
+
+
+/**
+ * @name    simple_pool_destroy
+ * @brief   Free every slab of the pool and the pool itself, including all live objects.
+ *          Slabs from an arena stay with the arena.
+ */
+void simple_pool_destroy(SimplePool * pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MM_POOL_H_ */
@@ -0,0 +1,400 @@
+/**
+ * @file   mm_preload.c
+ * @brief  The C allocation functions on top of simple_malloc, for LD_PRELOAD.
+ *
+ * make libsimplemm.so builds this file together with mm.c into a shared
+ * library, and LD_PRELOAD=./libsimplemm.so runs an unmodified program on it.
+ * The allocator only needs mmap and its own locks, so it can serve the
+ * first allocations libc makes while the program is still starting up.
+ *
+ * With SIMPLE_MM_TRACE=file in the environment every call is also recorded
+ * in the trace format of bench_mm. A "%p" in the name is replaced by the
+ * process id, so programs that fork and exec write one trace per process.
+ * Recording never allocates either: lines are formatted by hand into a
+ * static buffer, and the pointer-to-id map lives in its own mappings.
+ *
+ * Every lock is taken around fork and reset in the child, so a thread that
+ * forks while another allocates leaves the child an allocator it can use.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mm.h"
+
+#define TRACE_ENV        "SIMPLE_MM_TRACE"
+#define TRACE_BUFFER     (64 * 1024)   // Bytes of trace lines collected before one write
+#define ID_TABLE_INITIAL 4096          // Slots in the pointer-to-id map when it is created
+#define NO_ID            UINT32_MAX
+
+#define TRACE_UNKNOWN  -2  // The environment has not been checked yet
+#define TRACE_OFF      -1
+
+typedef struct id_slot {
+    uintptr_t ptr;    // Live block, 0 for an empty slot
+    uint32_t id;      // Trace id of the block
+} IdSlot;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;  // Protects everything below
+static int trace_fd = TRACE_UNKNOWN;
+static char trace_buffer[TRACE_BUFFER];
+static size_t trace_length = 0;
+
+static IdSlot *id_table = NULL;      // Open addressing with linear probing
+static size_t id_capacity = 0;       // A power of two
+static size_t id_count = 0;
+static uint32_t *free_ids = NULL;    // Ids of freed blocks, reused so ids stay dense
+static size_t free_id_count = 0;
+static size_t free_id_capacity = 0;
+static uint32_t next_id = 0;
+
+/**
+ * @name    map_grow
+ * @brief   Resize an array living in its own mapping, which need not exist yet.
+ * @retval  The new array or NULL if the kernel refused, in which case the old one is untouched.
+ */
+static void *map_grow(void *old, size_t old_bytes, size_t bytes) {
+    void *grown = (old == NULL) ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                                : mremap(old, old_bytes, bytes, MREMAP_MAYMOVE);
+    return (grown == MAP_FAILED) ? NULL : grown;
+}
+
+/**
+ * @name    id_slot
+ * @brief   Slot a pointer hashes to in a table of `capacity` slots.
+ */
+static size_t id_slot(uintptr_t ptr, size_t capacity) {
+    return (size_t)(((ptr >> 3) * 0x9e3779b97f4a7c15ull) >> 32) & (capacity - 1);
+}
+
+/**
+ * @name    id_store
+ * @brief   Record that `ptr` carries trace id `id`. Returns 0 if the table could not grow.
+ */
+static int id_store(uintptr_t ptr, uint32_t id) {
+    if (2 * (id_count + 1) > id_capacity) {
+        // Rehash into a fresh mapping of twice the size
+        size_t capacity = id_capacity ? 2 * id_capacity : ID_TABLE_INITIAL;
+        IdSlot *table = map_grow(NULL, 0, capacity * sizeof(IdSlot));
+        if (table == NULL) return 0;
+        for (size_t n = 0; n < id_capacity; n++) {
+            if (id_table[n].ptr == 0) continue;
+            size_t slot = id_slot(id_table[n].ptr, capacity);
+            while (table[slot].ptr != 0) slot = (slot + 1) & (capacity - 1);
+            table[slot] = id_table[n];
+        }
+        if (id_table != NULL) munmap(id_table, id_capacity * sizeof(IdSlot));
+        id_table = table;
+        id_capacity = capacity;
+    }
+
+    size_t slot = id_slot(ptr, id_capacity);
+    while (id_table[slot].ptr != 0 && id_table[slot].ptr != ptr) slot = (slot + 1) & (id_capacity - 1);
+    if (id_table[slot].ptr == 0) id_count++;
+    id_table[slot].ptr = ptr;
+    id_table[slot].id = id;
+    return 1;
+}
+
+/**
+ * @name    id_take
+ * @brief   Remove `ptr` from the map.
+ * @retval  Its trace id, or NO_ID if it was not recorded.
+ *
+ * Later entries of the probe run are shifted back, so no tombstones are needed.
+ */
+static uint32_t id_take(uintptr_t ptr) {
+    if (id_capacity == 0) return NO_ID;
+    size_t mask = id_capacity - 1;
+    size_t slot = id_slot(ptr, id_capacity);
+    while (id_table[slot].ptr != ptr) {
+        if (id_table[slot].ptr == 0) return NO_ID;
+        slot = (slot + 1) & mask;
+    }
+    uint32_t id = id_table[slot].id;
+
+    for (size_t next = (slot + 1) & mask; id_table[next].ptr != 0; next = (next + 1) & mask) {
+        // An entry may fill the hole if its home slot is not between the hole and itself
+        size_t home = id_slot(id_table[next].ptr, id_capacity);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            id_table[slot] = id_table[next];
+            slot = next;
+        }
+    }
+    id_table[slot].ptr = 0;
+    id_count--;
+    return id;
+}
+
+/**
+ * @name    id_new
+ * @brief   A trace id that no live block carries, preferring ids of freed blocks.
+ */
+static uint32_t id_new(void) {
+    return free_id_count > 0 ? free_ids[--free_id_count] : next_id++;
+}
+
+/**
+ * @name    id_release
+ * @brief   Make the id of a freed block available again.
+ */
+static void id_release(uint32_t id) {
+    if (free_id_count == free_id_capacity) {
+        size_t capacity = free_id_capacity ? 2 * free_id_capacity : ID_TABLE_INITIAL;
+        uint32_t *grown = map_grow(free_ids, free_id_capacity * sizeof(uint32_t), capacity * sizeof(uint32_t));
+        if (grown == NULL) return;  // The id is simply not reused
+        free_ids = grown;
+        free_id_capacity = capacity;
+    }
+    free_ids[free_id_count++] = id;
+}
+
+/**
+ * @name    trace_flush
+ * @brief   Write the collected trace lines. Caller holds the trace lock.
+ */
+static void trace_flush(void) {
+    size_t written = 0;
+    while (written < trace_length) {
+        ssize_t n = write(trace_fd, trace_buffer + written, trace_length - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;  // Lose the lines rather than stall the program
+        written += (size_t)n;
+    }
+    trace_length = 0;
+}
+
+/**
+ * @name    trace_append
+ * @brief   Append a string to the trace buffer. Caller holds the trace lock.
+ */
+static void trace_append(const char *text, size_t length) {
+    if (trace_length + length > TRACE_BUFFER) trace_flush();
+    memcpy(trace_buffer + trace_length, text, length);
+    trace_length += length;
+}
+
+/**
+ * @name    format_number
+ * @brief   Write `value` in decimal to the end of `end` and return where the digits start.
+ */
+static char *format_number(char *end, uint64_t value) {
+    do {
+        *--end = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+/**
+ * @name    trace_open
+ * @brief   Open the trace file named in the environment, if any. Caller holds the trace lock.
+ */
+static void trace_open(void) {
+    const char *name = getenv(TRACE_ENV);
+    trace_fd = TRACE_OFF;
+    if (name == NULL || name[0] == '\0') return;
+
+    // Copy the name, replacing "%p" by the process id
+    char path[4096], digits[24];
+    size_t length = 0;
+    for (const char *c = name; *c != '\0' && length < sizeof(path) - sizeof(digits); c++) {
+        if (c[0] == '%' && c[1] == 'p') {
+            char *pid = format_number(digits + sizeof(digits), (uint64_t)getpid());
+            size_t n = digits + sizeof(digits) - pid;
+            memcpy(path + length, pid, n);
+            length += n;
+            c++;
+        } else {
+            path[length++] = *c;
+        }
+    }
+    path[length] = '\0';
+
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd < 0) {
+        trace_fd = TRACE_OFF;
+        return;
+    }
+    const char header[] = "# simple_mm trace recorded by libsimplemm.so\n";
+    trace_append(header, sizeof(header) - 1);
+}
+
+/**
+ * @name    trace_record
+ * @brief   Record one call: `op` is 'a', 'f' or 'r', `old` the block passed in and `ptr` the block returned.
+ */
+static void trace_record(char op, void *old, void *ptr, size_t size) {
+    if (__atomic_load_n(&trace_fd, __ATOMIC_RELAXED) == TRACE_OFF) return;
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fd == TRACE_UNKNOWN) trace_open();
+    if (trace_fd == TRACE_OFF) {
+        pthread_mutex_unlock(&trace_lock);
+        return;
+    }
+
+    // A realloc of a block recorded before keeps its id, anything else is a new block
+    uint32_t id = NO_ID;
+    if (old != NULL) {
+        id = id_take((uintptr_t)old);
+        if (op == 'f' && id != NO_ID) id_release(id);
+    }
+    if (op != 'f') {
+        if (id == NO_ID) {
+            id = id_new();
+            op = 'a';
+        }
+        if (!id_store((uintptr_t)ptr, id)) id = NO_ID;
+    }
+
+    if (id != NO_ID) {
+        char line[64], *end = line + sizeof(line), *start = end;
+        *--start = '\n';
+        if (op != 'f') {
+            start = format_number(start, size);
+            *--start = ' ';
+        }
+        start = format_number(start, id);
+        *--start = ' ';
+        *--start = op;
+        trace_append(start, end - start);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+/**
+ * @name    trace_close
+ * @brief   Write what is left of the trace when the program exits.
+ */
+__attribute__((destructor)) static void trace_close(void) {
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fd >= 0) trace_flush();
+    pthread_mutex_unlock(&trace_lock);
+}
+
+/**
+ * @name    fork_prepare
+ * @brief   Take the trace lock and the allocator's locks before the process forks.
+ */
+static void fork_prepare(void) {
+    pthread_mutex_lock(&trace_lock);
+    simple_fork_prepare();
+}
+
+/**
+ * @name    fork_parent
+ * @brief   Release the locks taken by fork_prepare in the parent.
+ */
+static void fork_parent(void) {
+    simple_fork_parent();
+    pthread_mutex_unlock(&trace_lock);
+}
+
+/**
+ * @name    fork_child
+ * @brief   Reset the locks in the child. The parent writes the trace lines it collected, so the child drops them.
+ */
+static void fork_child(void) {
+    simple_fork_child();
+    trace_length = 0;
+    pthread_mutex_init(&trace_lock, NULL);
+}
+
+/**
+ * @name    fork_register
+ * @brief   Install the fork handlers when the library is loaded.
+ */
+__attribute__((constructor)) static void fork_register(void) {
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
+
+/**
+ * @name    allocated
+ * @brief   Record a new block, or set errno for a failed allocation. Returns `ptr`.
+ */
+static void *allocated(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        errno = ENOMEM;
+    } else {
+        trace_record('a', NULL, ptr, size);
+    }
+    return ptr;
+}
+
+void *malloc(size_t size) {
+    return allocated(simple_malloc(size), size);
+}
+
+void free(void *ptr) {
+    if (ptr == NULL) return;
+    trace_record('f', ptr, NULL, 0);  // Before the block can be handed out again
+    simple_free(ptr);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    return allocated(simple_calloc(nmemb, size), nmemb * size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (ptr != NULL && size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    void *new_ptr = simple_realloc(ptr, size);
+    if (new_ptr == NULL) {
+        errno = ENOMEM;
+    } else {
+        trace_record('r', ptr, new_ptr, size);
+    }
+    return new_ptr;
+}
+
+size_t malloc_usable_size(void *ptr) {
+    return simple_usable_size(ptr);
+}
+
+/* Aligned allocations are recorded as plain 'a' lines, the trace format has no alignment */
+
+void *memalign(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return allocated(simple_memalign(alignment, size), size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment == 0 || alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+    int saved = errno;
+    void *ptr = memalign(alignment, size);
+    errno = saved;  // posix_memalign reports failure by its result only
+    if (ptr == NULL) return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+void *valloc(size_t size) {
+    return memalign((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+void *pvalloc(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (size > SIZE_MAX - page) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return memalign(page, (size + page - 1) & ~(page - 1));
+}
@@ -0,0 +1,147 @@
+/**
+ * @file   size_classes.c
+ * @brief  Turns allocation profiles written by MM_PROFILE into the size classes of mm_classes.h.
+ *
+ * usage: size_classes profile... > mm_classes.h
+ *
+ * The profiles are summed. The classes always include one per power of two,
+ * so every size has a class; the remaining bins go to exact classes for the
+ * sizes whose blocks are freed most often, as those are the blocks that come
+ * back to a free list and are asked for again. Bins still left over split
+ * the smallest sizes, as the fixed classes do.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CLASS_EXACT 4096                    // Sizes up to here can get a class of their own, as profiled
+#define CLASS_COUNT 128                     // Bins of MM_SEGLIST
+#define MIN_POWER   4                       // Powers of two from 16 bytes...
+#define MAX_POWER   47                      // ...to the largest heap memory_setup.c can map
+#define SIZES       (CLASS_EXACT / 8 + 1)   // Profiled sizes that can get their own class, one per 8 bytes
+
+typedef struct size_profile {
+    unsigned long long requests;
+    unsigned long long frees;
+    unsigned long long lifetime;
+} SizeProfile;
+
+static SizeProfile sizes[SIZES];
+static unsigned long long total_requests = 0;
+
+/**
+ * @name    read_profile
+ * @brief   Add the profile in `path` to `sizes`.
+ * @retval  0 on success, -1 if the file could not be read.
+ */
+static int read_profile(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long long size, requests, frees, lifetime;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%llu %llu %llu %llu", &size, &requests, &frees, &lifetime) != 4) continue;
+        total_requests += requests;
+        if (size >= SIZES * 8) continue;  // Large sizes share the power-of-two classes
+        sizes[size / 8].requests += requests;
+        sizes[size / 8].frees += frees;
+        sizes[size / 8].lifetime += lifetime;
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @name    hotter
+ * @brief   Whether size `a` deserves an exact class more than size `b`: more frees, then more requests.
+ */
+static int hotter(unsigned a, unsigned b) {
+    if (sizes[a].frees != sizes[b].frees) return sizes[a].frees > sizes[b].frees;
+    return sizes[a].requests > sizes[b].requests;
+}
+
+/**
+ * @name    main
+ * @brief   Reads the profiles and prints mm_classes.h.
+ * @return  0 for success, 1 for a usage or read error.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s profile... > mm_classes.h\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (read_profile(argv[i]) != 0) {
+            fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[i]);
+            return 1;
+        }
+    }
+
+    // A bound is the smallest size of a class; bounds below CLASS_EXACT are marked per 8 bytes
+    static char bound[SIZES];
+    unsigned count = 1 + (MAX_POWER - MIN_POWER + 1);
+    bound[0] = 1;
+    for (unsigned power = MIN_POWER; (1u << power) < SIZES * 8; power++) bound[(1u << power) / 8] = 1;
+
+    // An exact class for size s needs bounds at s and s + 8
+    for (;;) {
+        unsigned best = 0;
+        for (unsigned s = 1; s < SIZES - 1; s++) {
+            if (sizes[s].frees == 0 || (bound[s] && bound[s + 1])) continue;
+            if (best == 0 || hotter(s, best)) best = s;
+        }
+        if (best == 0 || count + !bound[best] + !bound[best + 1] > CLASS_COUNT) break;
+        count += !bound[best] + !bound[best + 1];
+        bound[best] = bound[best + 1] = 1;
+    }
+    for (unsigned s = 1; s < SIZES && count < CLASS_COUNT; s++) {
+        if (!bound[s]) {
+            bound[s] = 1;
+            count++;
+        }
+    }
+
+    // Number the classes and print them
+    static unsigned char class_of[SIZES];
+    unsigned long long limits[CLASS_COUNT];
+    unsigned classes = 0;
+    for (unsigned s = 0; s < SIZES; s++) {
+        if (bound[s]) limits[classes++] = s * 8ull;
+        class_of[s] = (unsigned char)(classes - 1);
+    }
+    for (unsigned power = 1; classes < CLASS_COUNT; power++) {
+        if ((SIZES - 1) * 8ull < (1ull << power)) limits[classes++] = 1ull << power;
+    }
+
+    printf("/**\n");
+    printf(" * @file   mm_classes.h\n");
+    printf(" * @brief  Size classes for MM_SEGLIST with MM_CLASSES, generated by size_classes. Do not edit.\n");
+    printf(" *\n");
+    printf(" * Profiled from %llu requests in", total_requests);
+    for (int i = 1; i < argc; i++) printf(" %s", argv[i]);
+    printf(".\n */\n\n");
+    printf("#ifndef MM_CLASSES_H_\n#define MM_CLASSES_H_\n\n");
+    printf("#define CLASS_EXACT %d  // Sizes up to here are looked up in class_small\n\n", CLASS_EXACT);
+
+    printf("/* Class of each size up to CLASS_EXACT, indexed by size / 8 */\n");
+    printf("static const uint8_t class_small[CLASS_EXACT / 8 + 1] = {");
+    for (unsigned s = 0; s < SIZES; s++) printf("%s%u%s", (s % 16 == 0) ? "\n    " : " ", class_of[s], (s + 1 < SIZES) ? "," : "");
+    printf("\n};\n\n");
+
+    printf("/* Smallest size of each class */\n");
+    printf("static const uint64_t class_limits[%d] = {\n", CLASS_COUNT);
+    for (unsigned c = 0; c < CLASS_COUNT; c++) {
+        printf("    %lluull,", limits[c]);
+        unsigned s = (unsigned)(limits[c] / 8);
+        if (limits[c] < (SIZES - 1) * 8ull && (c + 1 == CLASS_COUNT || limits[c + 1] == limits[c] + 8) && sizes[s].requests > 0) {
+            printf("  // %llu requests, %llu frees, mean lifetime %.1f", sizes[s].requests, sizes[s].frees,
+                   sizes[s].frees ? (double)sizes[s].lifetime / (double)sizes[s].frees : 0.0);
+        }
+        printf("\n");
+    }
+    printf("};\n\n#endif /* MM_CLASSES_H_ */\n");
+    return 0;
+}